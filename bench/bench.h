@@ -0,0 +1,20 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <time.h>
+
+// Monotonic time in seconds
+static inline double bench_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Print one result as a JSON object on its own line
+static inline void bench_report(const char* name, const char* unit, double value) {
+    printf("{\"bench\": \"%s\", \"unit\": \"%s\", \"value\": %.3f}\n", name, unit, value);
+    fflush(stdout);
+}
+
+#endif
@@ -0,0 +1,30 @@
+#include "shell.h"
+#include "bench.h"
+
+// Command-name completion against the executables on PATH: the one-time
+// index build, then prefix queries, which should take microseconds
+// however many commands are installed.
+
+#define QUERIES 1000000
+
+int main() {
+    char* prefixes[] = {"g", "gr", "py", "ls", "x", "zz", "s", "ma"};
+    int num_prefixes = sizeof(prefixes) / sizeof(prefixes[0]);
+    char** matches;
+    long found = 0;
+    
+    init_variables();
+    
+    double start = bench_now();
+    complete_commands("", &matches);
+    bench_report("complete_index_build", "ms", (bench_now() - start) * 1000);
+    
+    start = bench_now();
+    for (int i = 0; i < QUERIES; i++) {
+        found += complete_commands(prefixes[i % num_prefixes], &matches);
+    }
+    double elapsed = bench_now() - start;
+    
+    bench_report("complete_prefix_query", "us", elapsed * 1e6 / QUERIES);
+    return found > 0 ? 0 : 1;
+}
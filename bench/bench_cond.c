@@ -0,0 +1,44 @@
+#include "shell.h"
+#include "bench.h"
+
+// A 10k-iteration conditional block: the in-process [ builtin against the
+// external /usr/bin/test binary. The builtin version starts no processes;
+// the external one starts one per iteration.
+
+#define ITERATIONS 10000
+
+static double run_block(char* source) {
+    arena_t arena;
+    arena_init(&arena);
+    char* text = strdup(source);
+    node_t* root = parse_program(&arena, text, NULL);
+    if (root == NULL) {
+        fprintf(stderr, "bench_cond: failed to parse: %s\n", source);
+        exit(1);
+    }
+    
+    double start = bench_now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        execute_node(root);
+    }
+    double elapsed = bench_now() - start;
+    
+    arena_free(&arena);
+    free(text);
+    return elapsed;
+}
+
+int main() {
+    init_jobs();
+    init_variables();
+    set_variable("A", "alpha");
+    
+    double builtin = run_block("if [ -f /etc/passwd ] && [ $A = alpha ]; then X=1; elif [ -d /etc ]; then X=2; fi");
+    double external = run_block("if /usr/bin/test -f /etc/passwd; then X=1; fi");
+    
+    bench_report("cond_builtin", "iterations/s", ITERATIONS / builtin);
+    bench_report("cond_builtin_processes", "count", 0);
+    bench_report("cond_external", "iterations/s", ITERATIONS / external);
+    bench_report("cond_external_processes", "count", ITERATIONS);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include "shell.h"
+#include "bench.h"
+
+// Cost of the environment handed to each command started, with a thousand
+// exported variables: fetching the cached array when nothing changed
+// (what every launch pays), and rebuilding it after one export changed.
+
+#define EXPORTS 1000
+#define FETCHES 10000000
+#define REBUILDS 10000
+
+int main() {
+    char name[32];
+    char value[32];
+    
+    init_variables();
+    for (int i = 0; i < EXPORTS; i++) {
+        snprintf(name, sizeof(name), "EXPORTED_%d", i);
+        snprintf(value, sizeof(value), "value_%d", i);
+        export_variable(name, value);
+    }
+    shell_environment();
+    
+    double start = bench_now();
+    long entries = 0;
+    for (int i = 0; i < FETCHES; i++) {
+        entries += shell_environment() != NULL;
+    }
+    bench_report("env_cached_1000", "ns/launch", (bench_now() - start) / FETCHES * 1e9);
+    
+    start = bench_now();
+    for (int i = 0; i < REBUILDS; i++) {
+        set_variable("EXPORTED_0", (i & 1) ? "odd" : "even");
+        if (shell_environment() == NULL) return 1;
+    }
+    bench_report("env_rebuild_1000", "us/change", (bench_now() - start) / REBUILDS * 1e6);
+    return entries == FETCHES ? 0 : 1;
+}
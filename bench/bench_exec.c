@@ -0,0 +1,22 @@
+#include "shell.h"
+#include "bench.h"
+
+// Commands per second for trivial external commands through execute()
+
+#define COMMANDS 2000
+
+int main() {
+    init_jobs();
+    init_variables();
+    
+    char* args[] = {"true", NULL};
+    
+    double start = bench_now();
+    for (int i = 0; i < COMMANDS; i++) {
+        execute(args);
+    }
+    double elapsed = bench_now() - start;
+    
+    bench_report("exec_true", "commands/s", COMMANDS / elapsed);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include "shell.h"
+#include "bench.h"
+
+// Here-document setup: turning a body into a stdin descriptor and reading
+// it back, for a small body (pipe) and a large one (memfd). Nothing is
+// written to disk, so the rate depends only on the body size.
+
+#define ROUNDS 20000
+
+static void run(const char* name, size_t size) {
+    command_t cmd;
+    char buffer[65536];
+    
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.here_text = malloc(size + 1);
+    memset(cmd.here_text, 'x', size);
+    cmd.here_text[size] = '\0';
+    
+    double start = bench_now();
+    for (int i = 0; i < ROUNDS; i++) {
+        int in_fd, out_fd;
+        if (setup_redirection(&cmd, &in_fd, &out_fd) < 0) exit(1);
+        while (read(in_fd, buffer, sizeof(buffer)) > 0);
+        close(in_fd);
+    }
+    bench_report(name, "ops/s", ROUNDS / (bench_now() - start));
+    free(cmd.here_text);
+}
+
+int main() {
+    run("heredoc_small_pipe", 200);
+    run("heredoc_large_memfd", 256 * 1024);
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "shell.h"
+#include "bench.h"
+
+// Persistent history with a million entries: opening it (which must not
+// depend on the file size once indexed), !n lookups, and Ctrl-R searches
+// through the trigram index: building and saving it, the first search of
+// a later shell that maps the saved copy, and repeated searches. The files
+// live in a temporary directory.
+
+#define ENTRIES 1000000
+#define LOOKUPS 1000000
+#define SEARCHES 1000
+
+int main() {
+    char dir[] = "/tmp/bench_history.XXXXXX";
+    char path[64];
+    
+    if (mkdtemp(dir) == NULL) return 1;
+    snprintf(path, sizeof(path), "%s/history", dir);
+    setenv("HISTFILE", path, 1);
+    
+    // The first start indexes the whole file; later ones only map it
+    FILE* file = fopen(path, "w");
+    for (int i = 0; i < ENTRIES; i++) {
+        fprintf(file, "grep -rn pattern_%d src/module_%d.c | sort | head -%d\n", i, i % 97, i % 50);
+    }
+    fclose(file);
+    init_variables();
+    init_history();
+    
+    double start = bench_now();
+    init_history();
+    bench_report("history_open_1M", "ms", (bench_now() - start) * 1000);
+    
+    start = bench_now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        char* command = get_history_command(1 + (int)((i * 7919L) % ENTRIES));
+        if (command == NULL) return 1;
+        free(command);
+    }
+    bench_report("history_get_n", "ops/s", LOOKUPS / (bench_now() - start));
+    
+    start = bench_now();
+    history_search("pattern_1", ENTRIES + 1);
+    bench_report("history_trigram_build_1M", "ms", (bench_now() - start) * 1000);
+    
+    // A new shell maps HISTFILE.tri instead of indexing again
+    init_history();
+    start = bench_now();
+    if (history_search("pattern_4242 ", ENTRIES + 1) == 0) return 1;
+    bench_report("history_first_search_saved_1M", "ms", (bench_now() - start) * 1000);
+    
+    char query[32];
+    start = bench_now();
+    for (int i = 0; i < SEARCHES; i++) {
+        snprintf(query, sizeof(query), "pattern_%d ", (i * 7919) % ENTRIES);
+        if (history_search(query, ENTRIES + 1) == 0) return 1;
+    }
+    bench_report("history_search", "ops/s", SEARCHES / (bench_now() - start));
+    
+    snprintf(path, sizeof(path), "rm -rf %s", dir);
+    if (system(path) != 0) return 1;
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include "shell.h"
+#include "bench.h"
+
+// Job-table churn with thousands of jobs alive at once: add_job(), a
+// pid lookup per job (what reaping a child costs) and remove_job(). The
+// pids are fake; only the bookkeeping is measured.
+
+#define ROUNDS 20
+#define BATCH 5000
+
+int main() {
+    job_t* jobs[BATCH];
+    
+    init_jobs();
+    
+    double start = bench_now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < BATCH; i++) {
+            pid_t pid = 1000000 + i;
+            jobs[i] = new_job(&pid, 1, pid);
+            add_job(jobs[i], "sleep 100");
+        }
+        for (int i = 0; i < BATCH; i++) {
+            if (find_job_by_pid(1000000 + i) != jobs[i]) return 1;
+        }
+        for (int i = 0; i < BATCH; i++) {
+            remove_job(jobs[i]);
+        }
+    }
+    double elapsed = bench_now() - start;
+    
+    bench_report("jobs_add_lookup_remove", "ops/s", 3.0 * ROUNDS * BATCH / elapsed);
+    return 0;
+}
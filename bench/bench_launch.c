@@ -0,0 +1,63 @@
+#include "shell.h"
+#include "bench.h"
+
+// Launch latency of fork+exec versus posix_spawn as the shell's RSS grows.
+// fork() has to copy the page tables of every touched page, posix_spawn()
+// (clone with CLONE_VM|CLONE_VFORK) does not.
+
+extern char** environ;
+
+#define LAUNCHES 500
+
+static double launch_fork(char* path, char** args) {
+    double start = bench_now();
+    for (int i = 0; i < LAUNCHES; i++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            execv(path, args);
+            _exit(127);
+        }
+        waitpid(pid, NULL, 0);
+    }
+    return (bench_now() - start) / LAUNCHES * 1e6;
+}
+
+static double launch_spawn(char* path, char** args) {
+    double start = bench_now();
+    for (int i = 0; i < LAUNCHES; i++) {
+        pid_t pid;
+        posix_spawn(&pid, path, NULL, NULL, args, environ);
+        waitpid(pid, NULL, 0);
+    }
+    return (bench_now() - start) / LAUNCHES * 1e6;
+}
+
+int main() {
+    char* args[] = {"true", NULL};
+    char* path = lookup_command("true");
+    if (path == NULL) {
+        fprintf(stderr, "bench_launch: true not found in PATH\n");
+        return 1;
+    }
+    
+    int sizes_mb[] = {0, 64, 256, 1024};
+    char* ballast = NULL;
+    
+    for (int i = 0; i < (int)(sizeof(sizes_mb) / sizeof(sizes_mb[0])); i++) {
+        // Grow RSS by touching every page of the ballast
+        size_t bytes = (size_t)sizes_mb[i] << 20;
+        free(ballast);
+        ballast = bytes ? malloc(bytes) : NULL;
+        if (bytes && ballast == NULL) break;
+        if (ballast) memset(ballast, 1, bytes);
+        
+        char name[64];
+        snprintf(name, sizeof(name), "launch_fork_rss_%dmb", sizes_mb[i]);
+        bench_report(name, "us/launch", launch_fork(path, args));
+        snprintf(name, sizeof(name), "launch_spawn_rss_%dmb", sizes_mb[i]);
+        bench_report(name, "us/launch", launch_spawn(path, args));
+    }
+    
+    free(ballast);
+    return 0;
+}
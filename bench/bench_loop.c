@@ -0,0 +1,62 @@
+#include "shell.h"
+#include "bench.h"
+
+// Loop iterations per second for bodies of in-process builtins: a for
+// loop over a split word list, nested for loops, and a while loop whose
+// condition is re-expanded on every pass. Each loop is parsed once and
+// walked by execute_node(), as the shell does for a typed loop.
+
+#define WORDS 100000
+
+static void run(const char* label, const char* source, long iterations, int rounds) {
+    arena_t arena;
+    arena_init(&arena);
+    char* text = strdup(source);
+    node_t* root = parse_program(&arena, text, NULL);
+    if (root == NULL) {
+        fprintf(stderr, "bench_loop: failed to parse: %s\n", source);
+        exit(1);
+    }
+    
+    reset_stats();
+    double start = bench_now();
+    for (int i = 0; i < rounds; i++) {
+        execute_node(root);
+    }
+    double elapsed = bench_now() - start;
+    
+    char name[64];
+    bench_report(label, "iterations/s", iterations * rounds / elapsed);
+    snprintf(name, sizeof(name), "%s_processes", label);
+    bench_report(name, "count", shell_stats.forks + shell_stats.execs);
+    
+    arena_free(&arena);
+    free(text);
+}
+
+int main() {
+    init_jobs();
+    init_variables();
+    arena_init(&line_arena);
+    
+    // 100k words for the for loop to split
+    char* list = malloc(WORDS * 7 + 1);
+    char* p = list;
+    for (int i = 0; i < WORDS; i++) {
+        p += sprintf(p, "%d ", i);
+    }
+    set_variable("LIST", list);
+    free(list);
+    
+    run("loop_for_colon", "for i in $LIST; do :; done", WORDS, 1);
+    run("loop_for_assign_test", "for i in $LIST; do X=$i; [ $X = 5 ] && Y=1; done", WORDS, 1);
+    run("loop_for_nested",
+        "for a in 0 1 2 3 4 5 6 7 8 9; do for b in 0 1 2 3 4 5 6 7 8 9; do "
+        "for c in 0 1 2 3 4 5 6 7 8 9; do for d in 0 1 2 3 4 5 6 7 8 9; do "
+        "for e in 0 1 2 3 4 5 6 7 8 9; do X=$a$b$c$d$e; done; done; done; done; done",
+        WORDS, 1);
+    // 1000 passes per run; the condition and the assignment are expanded
+    // again on each one
+    run("loop_while_test", "S=; while [ ${#S} -lt 1000 ]; do S=$S.; done", 1000, 100);
+    return 0;
+}
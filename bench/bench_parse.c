@@ -0,0 +1,52 @@
+#include "shell.h"
+#include "bench.h"
+
+// parse_program() throughput in lines/sec over a corpus of realistic
+// interactive and script lines.
+
+#define ROUNDS 200000
+
+static const char* corpus[] = {
+    "ls -la",
+    "cd /var/log",
+    "grep -rn \"TODO\" src include | sort | uniq -c > todo.txt",
+    "cat access.log | awk '{print $1}' | sort | uniq -c | sort -rn | head -20",
+    "make -j8 && ./bin/myshell || echo 'build failed'",
+    "tar czf backup.tar.gz $HOME/projects >> backup.log",
+    "find . -name '*.o' -newer Makefile ; echo done",
+    "NAME=\"John Doe\"",
+    "echo \"Hello, $NAME\" > greeting.txt",
+    "sleep 30 &",
+    "ps aux | grep myshell | grep -v grep | wc -l",
+    "git log --oneline --graph --decorate --all | head -n 50",
+    "sort < unsorted.txt > sorted.txt",
+    "for_each_file_script.sh a\\ b 'c d' \"e f\" g h i j k l m n o p",
+    "i=0; for f in *.c; do [ -f \"$f\" ] && wc -l \"$f\"; done | sort -n",
+};
+
+int main() {
+    int corpus_size = sizeof(corpus) / sizeof(corpus[0]);
+    char buffer[MAX_LEN];
+    long bytes = 0;
+    
+    double start = bench_now();
+    for (int i = 0; i < ROUNDS; i++) {
+        const char* line = corpus[i % corpus_size];
+        size_t len = strlen(line);
+        
+        // The parser terminates words in place, so work on a copy
+        memcpy(buffer, line, len + 1);
+        arena_mark_t mark = arena_mark(&line_arena);
+        if (parse_program(&line_arena, buffer, NULL) == NULL) {
+            fprintf(stderr, "bench_parse: failed to parse: %s\n", line);
+            return 1;
+        }
+        arena_release(&line_arena, mark);
+        bytes += len;
+    }
+    double elapsed = bench_now() - start;
+    
+    bench_report("parse_lines", "lines/s", ROUNDS / elapsed);
+    bench_report("parse_bytes", "MB/s", bytes / elapsed / 1e6);
+    return 0;
+}
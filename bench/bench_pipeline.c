@@ -0,0 +1,52 @@
+#include "shell.h"
+#include "bench.h"
+
+// Throughput of multi-stage pipelines: N bytes pushed from a producer
+// through cat stages into /dev/null, with the default pipe size and with
+// PIPESIZE raised to 1M, plus fanning the same stream out to two targets
+// in-kernel (> a > b) against a tee process.
+//
+// Usage: bench_pipeline [megabytes] (default 256; 1024 for the 1 GB runs)
+
+static double run_line(const char* line) {
+    char* buffer = strdup(line);
+    double start = bench_now();
+    execute_command_chain(buffer);
+    double elapsed = bench_now() - start;
+    free(buffer);
+    return elapsed;
+}
+
+int main(int argc, char** argv) {
+    long megabytes = argc > 1 ? atol(argv[1]) : 256;
+    char line[MAX_LEN];
+    
+    init_jobs();
+    init_variables();
+    
+    for (int stages = 1; stages <= 3; stages++) {
+        snprintf(line, sizeof(line), "head -c %ldM /dev/zero", megabytes);
+        for (int i = 0; i < stages; i++) {
+            strncat(line, " | cat", sizeof(line) - strlen(line) - 1);
+        }
+        strncat(line, " > /dev/null", sizeof(line) - strlen(line) - 1);
+        
+        double elapsed = run_line(line);
+        
+        char name[64];
+        snprintf(name, sizeof(name), "pipeline_%d_stage", stages + 1);
+        bench_report(name, "MB/s", megabytes / elapsed);
+    }
+    
+    set_variable("PIPESIZE", "1M");
+    snprintf(line, sizeof(line), "head -c %ldM /dev/zero | cat | cat > /dev/null", megabytes);
+    bench_report("pipeline_3_stage_pipesize_1M", "MB/s", megabytes / run_line(line));
+    set_variable("PIPESIZE", "");
+    
+    snprintf(line, sizeof(line), "head -c %ldM /dev/zero > /dev/null > /dev/null", megabytes);
+    bench_report("fanout_2_targets_splice", "MB/s", megabytes / run_line(line));
+    
+    snprintf(line, sizeof(line), "head -c %ldM /dev/zero | tee /dev/null > /dev/null", megabytes);
+    bench_report("fanout_2_targets_tee_process", "MB/s", megabytes / run_line(line));
+    return 0;
+}
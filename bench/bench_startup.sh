@@ -0,0 +1,30 @@
+#!/bin/sh
+# Startup time of myshell -c against dash and bash.
+# Usage: bench/bench_startup.sh [path/to/myshell] [runs]
+
+MYSHELL=${1:-bin/myshell}
+RUNS=${2:-1000}
+
+now_ns() {
+    date +%s%N
+}
+
+measure() {
+    name=$1
+    shift
+    if ! command -v "$1" >/dev/null 2>&1; then
+        return
+    fi
+    start=$(now_ns)
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        "$@" -c true
+        i=$((i + 1))
+    done
+    end=$(now_ns)
+    echo "{\"bench\": \"startup_$name\", \"unit\": \"us/run\", \"value\": $(( (end - start) / RUNS / 1000 ))}"
+}
+
+measure myshell "$MYSHELL"
+measure dash dash
+measure bash bash
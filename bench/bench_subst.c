@@ -0,0 +1,28 @@
+#include "shell.h"
+#include "bench.h"
+
+// Command substitutions per second: one that needs a subshell and an
+// external command, and one that is a lone builtin run without forking.
+
+#define FORKED 1000
+#define IN_SHELL 100000
+
+int main() {
+    size_t length;
+    
+    init_jobs();
+    init_variables();
+    
+    double start = bench_now();
+    for (int i = 0; i < FORKED; i++) {
+        free(command_substitution("/bin/echo x", 11, &length));
+    }
+    bench_report("subst_external", "substitutions/s", FORKED / (bench_now() - start));
+    
+    start = bench_now();
+    for (int i = 0; i < IN_SHELL; i++) {
+        free(command_substitution("test -d /", 9, &length));
+    }
+    bench_report("subst_builtin", "substitutions/s", IN_SHELL / (bench_now() - start));
+    return 0;
+}
@@ -0,0 +1,61 @@
+#include "shell.h"
+#include "bench.h"
+
+// set_variable()/get_variable() rates as the variable table grows.
+// With the hashed store the per-lookup cost should stay flat from a
+// hundred to ten thousand variables.
+
+#define LOOKUPS 1000000
+
+int main() {
+    int sizes[] = {100, 1000, 10000};
+    char name[32];
+    char value[32];
+    
+    for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++) {
+        int n = sizes[s];
+        init_variables();
+        
+        double start = bench_now();
+        for (int i = 0; i < n; i++) {
+            snprintf(name, sizeof(name), "VAR_%d", i);
+            snprintf(value, sizeof(value), "value_%d", i);
+            set_variable(name, value);
+        }
+        double set_time = bench_now() - start;
+        
+        // Build the names up front so only the lookup is timed
+        char** names = malloc(n * sizeof(char*));
+        for (int i = 0; i < n; i++) {
+            snprintf(name, sizeof(name), "VAR_%d", i);
+            names[i] = strdup(name);
+        }
+        
+        start = bench_now();
+        long found = 0;
+        for (int i = 0; i < LOOKUPS; i++) {
+            if (get_variable(names[i % n]) != NULL) found++;
+        }
+        double get_time = bench_now() - start;
+        
+        // Overwrite every value; same-size updates reuse their slab chunk
+        start = bench_now();
+        for (int i = 0; i < LOOKUPS; i++) {
+            set_variable(names[i % n], (i & 1) ? "odd" : "even");
+        }
+        double update_time = bench_now() - start;
+        
+        char label[64];
+        snprintf(label, sizeof(label), "var_set_new_%d", n);
+        bench_report(label, "ns/op", set_time / n * 1e9);
+        snprintf(label, sizeof(label), "var_get_%d", n);
+        bench_report(label, "ns/op", get_time / LOOKUPS * 1e9);
+        snprintf(label, sizeof(label), "var_update_%d", n);
+        bench_report(label, "ns/op", update_time / LOOKUPS * 1e9);
+        
+        if (found != LOOKUPS) fprintf(stderr, "bench_vars: lost variables\n");
+        for (int i = 0; i < n; i++) free(names[i]);
+        free(names);
+    }
+    return 0;
+}
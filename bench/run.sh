@@ -0,0 +1,22 @@
+#!/bin/sh
+# Run every benchmark and print one JSON document with all results.
+# Usage: bench/run.sh [bindir]
+
+BINDIR=${1:-bin}
+BENCHDIR=$(dirname "$0")
+VERSION=$(git describe --always --dirty 2>/dev/null || echo unknown)
+
+results=$(
+    for bench in "$BINDIR"/bench_*; do
+        [ -x "$bench" ] && "$bench"
+    done
+    "$BENCHDIR"/bench_startup.sh "$BINDIR/myshell" 200
+)
+
+echo "{"
+echo "  \"version\": \"$VERSION\","
+echo "  \"date\": \"$(date -u +%Y-%m-%dT%H:%M:%SZ)\","
+echo "  \"results\": ["
+echo "$results" | grep '^{' | sed 's/^/    /; $!s/$/,/'
+echo "  ]"
+echo "}"
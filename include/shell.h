@@ -0,0 +1,376 @@
+#ifndef SHELL_H
+#define SHELL_H
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // pipe2, F_SETPIPE_SZ and friends
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <signal.h>
+#include <readline/readline.h>
+#include <readline/history.h>
+
+#define MAX_LEN 1024
+#define PROMPT "myshell> "
+#define HISTORY_SIZE 20
+
+// Structure for shell variable
+typedef struct {
+    char* name;         // interned, lives as long as the shell
+    char* value;        // slab string, NULL once unset
+    unsigned int hash;
+    int exported;       // passed to the commands the shell starts
+} variable_t;
+
+// Block of a bump allocator
+typedef struct arena_block {
+    struct arena_block* next;
+    size_t size;
+    size_t used;
+    char data[];
+} arena_block_t;
+
+// Bump allocator: many small allocations released together
+typedef struct {
+    arena_block_t* head;
+} arena_t;
+
+// Position in an arena to roll back to
+typedef struct {
+    arena_block_t* block;
+    size_t used;
+} arena_mark_t;
+
+// Lexer token types
+typedef enum {
+    TOK_WORD,
+    TOK_PIPE,    // |
+    TOK_AND,     // &&
+    TOK_OR,      // ||
+    TOK_SEQ,     // ;
+    TOK_BG,      // &
+    TOK_LESS,    // <
+    TOK_GREAT,   // >
+    TOK_DGREAT,  // >>
+    TOK_DLESS,   // <<
+    TOK_DLESSDASH, // <<-
+    TOK_TLESS,   // <<<
+    TOK_NEWLINE,
+    TOK_END,
+    TOK_ERROR
+} token_type_t;
+
+// A token is a span of the input buffer; words are NUL-terminated in place
+// and keep their quotes until expansion
+typedef struct {
+    token_type_t type;
+    char* text;
+    int len;
+} token_t;
+
+// Single-pass lexer state over a mutable input buffer
+typedef struct {
+    char* pos;
+    char saved; // operator character overwritten by the previous word's NUL
+} lexer_t;
+
+// An output redirection target beyond the first (cmd > a > b)
+typedef struct {
+    char* file;
+    int append;
+} output_target_t;
+
+// Structure for command with redirection
+typedef struct {
+    char** args; // NULL-terminated
+    int argc;
+    char* input_file;
+    char* output_file;
+    int append_output;
+    output_target_t* extra_outputs; // further > / >> targets, fed by a tee helper
+    int num_extra_outputs;
+    char* here_text;  // here-document body or here-string, used as stdin
+    int here_kind;    // HERE_*
+    int background;
+    struct node* compound; // if/while/until/for run as this stage instead of args
+    int conditional;       // args are [[ ... ]]: expanded without splitting or globbing
+} command_t;
+
+// What here_text holds before expansion
+enum { HERE_NONE, HERE_DOC, HERE_DOC_QUOTED, HERE_STRING };
+
+// Job states
+enum { JOB_QUEUED, JOB_RUNNING, JOB_STOPPED, JOB_DONE };
+
+// One launched pipeline: its stages plus any fan-out helpers. With job
+// control on they all share the process group pgid. A background job
+// over the JOBS_MAX limit is queued with a private copy of its commands
+// and no processes yet.
+typedef struct job {
+    pid_t pgid;         // first process started
+    pid_t last_pid;     // last stage; its status is the job's status
+    char* command;
+    int job_id;         // 0 until the job enters the job table
+    int state;          // JOB_*
+    int status;         // exit status of last_pid (128+sig if killed)
+    int signaled;       // last_pid was killed by a signal
+    int live;           // processes not reaped yet
+    int notify;         // queued for the next update_jobs() report
+    struct job* next_notify;
+    int nice;           // JOB_NICE when submitted
+    char* cpus;         // JOB_CPUS when submitted, or NULL
+    arena_t* arena;     // JOB_QUEUED: holds commands until the job starts
+    command_t* commands;
+    int num_commands;
+    struct job* next_queued;
+    int num_pids;
+    pid_t pids[];       // -1 once reaped
+} job_t;
+
+// Structure for pipeline: stages joined by |
+typedef struct pipeline {
+    command_t* commands;
+    int num_commands;
+    int background;
+    int timed;            // prefixed with the time keyword
+} pipeline_t;
+
+// Syntax tree node types
+typedef enum {
+    NODE_LIST,     // commands run in order
+    NODE_PIPELINE,
+    NODE_AND,      // cond && other
+    NODE_OR,       // cond || other
+    NODE_IF,       // if cond then body else other (elif nests another NODE_IF)
+    NODE_WHILE,    // while cond do body done
+    NODE_UNTIL,    // until cond do body done
+    NODE_FOR       // for name in words do body done
+} node_type_t;
+
+// Syntax tree node, built once by parse_program()
+typedef struct node {
+    node_type_t type;
+    pipeline_t* pipeline;  // NODE_PIPELINE
+    struct node* cond;     // NODE_IF/WHILE/UNTIL condition, left side of && / ||
+    struct node* body;     // NODE_LIST first child, NODE_IF then branch, loop body
+    struct node* other;    // NODE_IF else branch, right side of && / ||
+    struct node* next;     // next sibling inside a NODE_LIST
+    char* name;            // NODE_FOR variable
+    char** words;          // NODE_FOR words, unexpanded, NULL-terminated
+} node_t;
+
+// Cumulative counters shown by the stats builtin
+typedef struct {
+    unsigned long forks;
+    unsigned long execs;
+    unsigned long jobs_reaped;
+    unsigned long stages_elided;
+    unsigned long parse_calls;
+    unsigned long expand_calls;
+    unsigned long waits;
+    long long parse_ns;
+    long long expand_ns;
+    long long wait_ns;
+} shell_stats_t;
+
+extern shell_stats_t shell_stats;
+
+// Options toggled with set -o / set +o
+typedef struct {
+    int pipeopt; // run optimize_pipeline() before launching pipelines
+} shell_options_t;
+
+extern shell_options_t shell_options;
+
+// Job table size, and whether pipelines get their own process groups
+extern int job_count;
+extern int job_control;
+
+// Arena holding parsed command lines
+extern arena_t line_arena;
+
+// Global variable list, in insertion order
+extern variable_t* variable_list;
+extern int variable_count;
+
+// Special parameters: $? $$ $!, whether the last expansion failed, and
+// the status of the last command substitution
+extern int last_status;
+extern pid_t shell_pid;
+extern pid_t last_background_pid;
+extern int expansion_error;
+extern int substitution_status;
+
+// Function declarations
+char* read_cmd(char* prompt);
+
+// Statistics
+long long stats_clock();
+void reset_stats();
+void execute_stats(char** args);
+void print_time_report(long long real_ns, struct rusage* usage);
+
+// Input sources
+void input_interactive();
+int input_is_interactive();
+void input_open_string(const char* text);
+void input_open_fd(int fd);
+int input_open_file(const char* path);
+void input_close();
+char* input_read_line(const char* prompt);
+char* input_slurp(int fd, size_t* length);
+
+// Interactive event loop
+int init_events();
+char* event_read_line(const char* prompt);
+int events_child_mask(sigset_t* mask);
+
+char* read_multiline_cmd(char* prompt);
+int execute(char* arglist[]);
+
+// Enhanced parsing functions
+void lexer_init(lexer_t* lexer, char* input);
+void lex_next(lexer_t* lexer, token_t* token);
+char* skip_substitution(char* p);
+char* skip_backquote(char* p);
+char* here_delimiter(char* word);
+node_t* parse_program(arena_t* arena, char* text, int* incomplete);
+int is_variable_assignment(char* token);
+
+// Memory pools
+void arena_init(arena_t* arena);
+void* arena_alloc(arena_t* arena, size_t size);
+char* arena_strdup(arena_t* arena, const char* s);
+char* arena_strndup(arena_t* arena, const char* s, size_t len);
+void arena_reset(arena_t* arena);
+void arena_free(arena_t* arena);
+arena_mark_t arena_mark(arena_t* arena);
+void arena_release(arena_t* arena, arena_mark_t mark);
+char* slab_store(char* old, const char* value);
+void slab_release(char* s);
+
+// Variable functions
+void init_variables();
+int set_variable(char* name, char* value);
+char* get_variable(char* name);
+int export_variable(char* name, char* value);
+int unset_variable(char* name);
+int is_name(const char* name);
+char** shell_environment();
+void print_variables();
+int handle_variable_assignment(char* assignment);
+
+// Word expansion
+void expand_variables(char*** arglist);
+char* expand_word(char* word);
+char* expand_pattern(char* word);
+void expand_conditional(char** args);
+char* expand_here_document(char* body);
+
+// Pathname expansion
+int glob_pathnames(const char* pattern, char*** matches);
+int glob_is_pattern(const char* word);
+void glob_cache_clear();
+
+// Command location cache
+char* lookup_command(char* name);
+int hash_command(char* name);
+void clear_command_hash();
+void print_command_hash();
+
+// Execution functions
+int execute_pipeline(pipeline_t* pipeline);
+int run_pipeline(pipeline_t* pipeline);
+int optimize_pipeline(pipeline_t* pipeline);
+int execute_single_command(command_t* cmd);
+int execute_command_chain(char* cmdline);
+int setup_redirection(command_t* cmd, int* in_fd, int* out_fd);
+int setup_pipes(pipeline_t* pipeline, int pipefds[][2]);
+job_t* start_pipeline(command_t* commands, int n);
+pid_t spawn_external(char** args, int in_fd, int out_fd, pid_t* pgid);
+
+// Control structure functions
+char* read_here_documents(char* cmdline);
+node_t* read_program(char* first_line, char** text);
+int execute_node(node_t* node);
+int execute_break(char** args);
+int execute_continue(char** args);
+
+// Job control functions
+void init_jobs();
+void init_job_control();
+void job_control_signals(sigset_t* set);
+void restore_job_signals();
+job_t* new_job(pid_t* pids, int num_pids, pid_t last_pid);
+void free_job(job_t* job);
+int add_job(job_t* job, char* command);
+void submit_job(command_t* commands, int num_commands, char* command);
+void remove_job(job_t* job);
+job_t* find_job_by_pid(pid_t pid);
+int wait_for_job(job_t* job, int foreground, struct rusage* usage);
+void update_jobs();
+void print_jobs();
+int cleanup_zombies();
+
+// Built-in command functions
+typedef struct {
+    char* name;
+    int (*run)(char** args);    // returns the exit status
+} builtin_t;
+
+extern int builtin_status;
+extern builtin_t builtins[];
+int handle_builtin(char** arglist);
+int is_builtin(char* name);
+void execute_cd(char** args);
+void execute_help();
+void execute_jobs();
+int execute_fg(char** args);
+int execute_bg(char** args);
+int execute_wait(char** args);
+int execute_kill(char** args);
+int execute_parallel(char** args);
+int execute_xargs(char** args);
+void execute_history(char** args);
+void execute_set(char** args);
+void execute_export(char** args);
+void execute_unset(char** args);
+void execute_hash(char** args);
+int execute_test(char** args);
+int execute_conditional(char** args);
+void test_cache_clear();
+int execute_echo(char** args);
+int execute_printf(char** args);
+int execute_pwd(char** args);
+int execute_true(char** args);
+int execute_false(char** args);
+int execute_read(char** args);
+
+// Command substitution
+char* command_substitution(const char* text, size_t length, size_t* output_length);
+
+// Tab completion
+void init_completion();
+int complete_commands(const char* prefix, char*** matches);
+
+// History functions
+void init_history();
+int history_entries();
+int history_search(const char* query, int before);
+void add_to_history(const char* command);
+void print_history(int count);
+char* get_history_command(int n);
+void handle_history_execution(char** cmdline);
+
+#endif
@@ -0,0 +1,163 @@
+#include "shell.h"
+
+// Memory pools used where the shell makes many small allocations.
+//
+// arena_t is a bump allocator: allocations are carved out of large blocks
+// and released all at once with arena_reset()/arena_free(), or back to an
+// earlier arena_mark() with arena_release().
+//
+// The slab_* functions hand out strings from power-of-two size classes
+// with a free list per class, so a string that is replaced over and over
+// (a variable value) reuses its old chunk instead of going through
+// malloc/free every time.
+
+#define ARENA_BLOCK_SIZE 8192
+
+void arena_init(arena_t* arena) {
+    arena->head = NULL;
+}
+
+void* arena_alloc(arena_t* arena, size_t size) {
+    size = (size + 15) & ~(size_t)15; // keep everything 16-byte aligned
+    
+    arena_block_t* block = arena->head;
+    if (block == NULL || block->used + size > block->size) {
+        size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(arena_block_t) + block_size);
+        if (block == NULL) {
+            perror("malloc");
+            exit(1);
+        }
+        block->size = block_size;
+        block->used = 0;
+        block->next = arena->head;
+        arena->head = block;
+    }
+    
+    void* ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+char* arena_strndup(arena_t* arena, const char* s, size_t len) {
+    char* copy = arena_alloc(arena, len + 1);
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+char* arena_strdup(arena_t* arena, const char* s) {
+    return arena_strndup(arena, s, strlen(s));
+}
+
+// Drop every allocation but keep one block around for reuse
+void arena_reset(arena_t* arena) {
+    if (arena->head == NULL) return;
+    
+    arena_block_t* block = arena->head->next;
+    while (block != NULL) {
+        arena_block_t* next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->head->next = NULL;
+    arena->head->used = 0;
+}
+
+void arena_free(arena_t* arena) {
+    arena_reset(arena);
+    free(arena->head);
+    arena->head = NULL;
+}
+
+// Remember the current end of the arena
+arena_mark_t arena_mark(arena_t* arena) {
+    // Make sure there is a block, so releasing back here keeps it cached
+    if (arena->head == NULL) arena_alloc(arena, 0);
+    
+    arena_mark_t mark;
+    mark.block = arena->head;
+    mark.used = arena->head->used;
+    return mark;
+}
+
+// Drop everything allocated since mark was taken
+void arena_release(arena_t* arena, arena_mark_t mark) {
+    while (arena->head != NULL && arena->head != mark.block) {
+        arena_block_t* next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+    if (arena->head != NULL) arena->head->used = mark.used;
+}
+
+// ---------------------------------------------------------------------------
+// Slab strings
+// ---------------------------------------------------------------------------
+
+#define SLAB_MIN_SHIFT 4   // smallest class holds 16 bytes
+#define SLAB_CLASSES 8     // largest class holds 2048 bytes
+#define SLAB_LARGE 0xff    // class tag for strings that went to malloc
+
+// Every slab string is preceded by a 16-byte header recording its class
+typedef union slab_chunk {
+    union slab_chunk* next_free;
+    unsigned char size_class;
+    char pad[16];
+} slab_chunk_t;
+
+static arena_t slab_arena;
+static slab_chunk_t* slab_free_lists[SLAB_CLASSES];
+
+static int slab_class_for(size_t size) {
+    int c = 0;
+    while (c < SLAB_CLASSES && ((size_t)1 << (c + SLAB_MIN_SHIFT)) < size) c++;
+    return c < SLAB_CLASSES ? c : SLAB_LARGE;
+}
+
+// Copy value into a slab chunk, reusing old's chunk when the value fits
+char* slab_store(char* old, const char* value) {
+    size_t size = strlen(value) + 1;
+    int size_class = slab_class_for(size);
+    
+    if (old != NULL) {
+        slab_chunk_t* chunk = (slab_chunk_t*)old - 1;
+        if (chunk->size_class == size_class && size_class != SLAB_LARGE) {
+            memcpy(old, value, size);
+            return old;
+        }
+        slab_release(old);
+    }
+    
+    slab_chunk_t* chunk;
+    if (size_class == SLAB_LARGE) {
+        chunk = malloc(sizeof(slab_chunk_t) + size);
+        if (chunk == NULL) {
+            perror("malloc");
+            exit(1);
+        }
+    } else if (slab_free_lists[size_class] != NULL) {
+        chunk = slab_free_lists[size_class];
+        slab_free_lists[size_class] = chunk->next_free;
+    } else {
+        chunk = arena_alloc(&slab_arena, sizeof(slab_chunk_t) + ((size_t)1 << (size_class + SLAB_MIN_SHIFT)));
+    }
+    
+    chunk->size_class = size_class;
+    memcpy(chunk + 1, value, size);
+    return (char*)(chunk + 1);
+}
+
+// Give a slab string's chunk back to its class
+void slab_release(char* s) {
+    if (s == NULL) return;
+    
+    slab_chunk_t* chunk = (slab_chunk_t*)s - 1;
+    int size_class = chunk->size_class;
+    if (size_class == SLAB_LARGE) {
+        free(chunk);
+        return;
+    }
+    chunk->next_free = slab_free_lists[size_class];
+    slab_free_lists[size_class] = chunk;
+}
@@ -0,0 +1,364 @@
+#include "shell.h"
+#include <errno.h>
+#include <limits.h>
+
+// Builtins standing in for the commands scripts run most: echo, printf,
+// pwd, true, false, :, read, and cd. They run inside the shell, with any
+// redirection applied to the shell's own descriptors for the duration
+// (see run_in_shell()), so none of them costs a process unless it is one
+// stage of a pipeline.
+
+// Write the character for the escape at *p (just past the backslash) and
+// advance *p past it. Returns 1 for \c, which ends all output.
+static int put_escape(const char** p) {
+    char c = **p;
+    (*p)++;
+    
+    switch (c) {
+        case 'n': putchar('\n'); break;
+        case 't': putchar('\t'); break;
+        case 'r': putchar('\r'); break;
+        case 'a': putchar('\a'); break;
+        case 'b': putchar('\b'); break;
+        case 'f': putchar('\f'); break;
+        case 'v': putchar('\v'); break;
+        case 'e': putchar('\033'); break;
+        case '\\': putchar('\\'); break;
+        case 'c': return 1;
+        case '0': {
+            // \0nnn: up to three octal digits
+            int value = 0;
+            for (int i = 0; i < 3 && **p >= '0' && **p <= '7'; i++) {
+                value = value * 8 + (*(*p)++ - '0');
+            }
+            putchar(value);
+            break;
+        }
+        case '\0':
+            putchar('\\');
+            (*p)--;
+            break;
+        default:
+            putchar('\\');
+            putchar(c);
+            break;
+    }
+    return 0;
+}
+
+// Print s, expanding backslash escapes. Returns 1 if \c stopped it.
+static int put_escaped(const char* s) {
+    while (*s != '\0') {
+        if (*s != '\\') {
+            putchar(*s++);
+        } else {
+            s++;
+            if (put_escape(&s)) return 1;
+        }
+    }
+    return 0;
+}
+
+// echo [-neE] [args...]
+int execute_echo(char** args) {
+    int newline = 1;
+    int escapes = 0;
+    int i = 1;
+    
+    // Only words made entirely of n, e and E letters are options
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+        if (strspn(args[i] + 1, "neE") != strlen(args[i] + 1)) break;
+        for (char* o = args[i] + 1; *o != '\0'; o++) {
+            if (*o == 'n') newline = 0;
+            else escapes = (*o == 'e');
+        }
+    }
+    
+    for (int first = i; args[i] != NULL; i++) {
+        if (i > first) putchar(' ');
+        if (!escapes) {
+            fputs(args[i], stdout);
+        } else if (put_escaped(args[i])) {
+            return 0;
+        }
+    }
+    if (newline) putchar('\n');
+    return 0;
+}
+
+// Numeric argument for printf; a leading quote gives the character's code
+static long long printf_number(const char* arg, int* status) {
+    if (arg[0] == '\'' || arg[0] == '"') return (unsigned char)arg[1];
+    
+    char* end;
+    errno = 0;
+    long long value = strtoll(arg, &end, 0);
+    if (end == arg || *end != '\0' || errno != 0) {
+        fprintf(stderr, "printf: %s: invalid number\n", arg);
+        *status = 1;
+    }
+    return value;
+}
+
+// printf FORMAT [args...]. The format is reused until the arguments run
+// out; missing arguments count as empty strings or zero.
+int execute_printf(char** args) {
+    if (args[1] == NULL) {
+        fprintf(stderr, "printf: usage: printf format [arguments]\n");
+        return 2;
+    }
+    
+    const char* format = args[1];
+    char** arg = &args[2];
+    int status = 0;
+    
+    do {
+        int used = 0;
+        for (const char* p = format; *p != '\0';) {
+            if (*p == '\\') {
+                p++;
+                if (put_escape(&p)) return status;
+                continue;
+            }
+            if (*p != '%') {
+                putchar(*p++);
+                continue;
+            }
+            if (p[1] == '%') {
+                putchar('%');
+                p += 2;
+                continue;
+            }
+            
+            // Copy flags, width and precision into a spec for libc
+            char spec[32];
+            size_t length = strspn(p + 1, "-+ #0123456789.") + 1;
+            if (length > sizeof(spec) - 4 || p[length] == '\0') {
+                fputs(p, stdout);
+                break;
+            }
+            memcpy(spec, p, length);
+            char conversion = p[length];
+            p += length + 1;
+            
+            const char* value = *arg != NULL ? *arg++ : NULL;
+            used = 1;
+            switch (conversion) {
+                case 's':
+                    spec[length] = 's';
+                    spec[length + 1] = '\0';
+                    printf(spec, value != NULL ? value : "");
+                    break;
+                case 'b':
+                    if (value != NULL && put_escaped(value)) return status;
+                    break;
+                case 'c':
+                    if (value != NULL && value[0] != '\0') putchar(value[0]);
+                    break;
+                case 'd':
+                case 'i':
+                case 'o':
+                case 'u':
+                case 'x':
+                case 'X':
+                    strcpy(spec + length, "ll");
+                    spec[length + 2] = conversion;
+                    spec[length + 3] = '\0';
+                    printf(spec, value != NULL ? printf_number(value, &status) : 0LL);
+                    break;
+                case 'e':
+                case 'E':
+                case 'f':
+                case 'F':
+                case 'g':
+                case 'G':
+                    spec[length] = conversion;
+                    spec[length + 1] = '\0';
+                    printf(spec, value != NULL ? strtod(value, NULL) : 0.0);
+                    break;
+                default:
+                    fprintf(stderr, "printf: %%%c: invalid conversion\n", conversion);
+                    return 1;
+            }
+        }
+        // A format without conversions is printed once
+        if (!used) break;
+    } while (*arg != NULL);
+    return status;
+}
+
+// pwd: print the working directory
+int execute_pwd(char** args) {
+    (void)args;
+    char path[PATH_MAX];
+    
+    if (getcwd(path, sizeof(path)) == NULL) {
+        perror("pwd");
+        return 1;
+    }
+    puts(path);
+    return 0;
+}
+
+int execute_true(char** args) {
+    (void)args;
+    return 0;
+}
+
+int execute_false(char** args) {
+    (void)args;
+    return 1;
+}
+
+// One line from standard input, without its newline, into *line. Reads
+// past the line only when the input can be seeked back; from a pipe or a
+// terminal it goes a byte at a time so nothing meant for later commands is
+// consumed. Returns -1 at end of input with nothing read.
+static ssize_t read_line(char** line, size_t* capacity) {
+    size_t length = 0;
+    int seekable = lseek(STDIN_FILENO, 0, SEEK_CUR) >= 0;
+    
+    while (1) {
+        if (length + 512 > *capacity) {
+            *capacity = (length + 512) * 2;
+            *line = realloc(*line, *capacity);
+        }
+        ssize_t n = read(STDIN_FILENO, *line + length, seekable ? *capacity - length - 1 : 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            (*line)[length] = '\0';
+            return length > 0 ? (ssize_t)length : -1;
+        }
+        
+        char* newline = memchr(*line + length, '\n', n);
+        if (newline != NULL) {
+            // Give back what followed the newline
+            if (seekable) lseek(STDIN_FILENO, -((*line + length + n) - (newline + 1)), SEEK_CUR);
+            *newline = '\0';
+            return newline - *line;
+        }
+        length += n;
+    }
+}
+
+// read [-r] [-p prompt] [name...]: split a line of input on IFS into the
+// names, the last one taking the rest of the line (REPLY by default).
+// Without -r a backslash escapes the next character and a trailing one
+// continues the line.
+int execute_read(char** args) {
+    int raw = 0;
+    int i = 1;
+    
+    for (; args[i] != NULL && args[i][0] == '-'; i++) {
+        if (strcmp(args[i], "-r") == 0) {
+            raw = 1;
+        } else if (strcmp(args[i], "-p") == 0 && args[i + 1] != NULL) {
+            fputs(args[++i], stderr);
+        } else {
+            fprintf(stderr, "read: usage: read [-r] [-p prompt] [name ...]\n");
+            return 2;
+        }
+    }
+    
+    static char* reply[] = {"REPLY", NULL};
+    char** names = args[i] != NULL ? &args[i] : reply;
+    char* ifs = get_variable("IFS");
+    if (ifs == NULL) ifs = " \t\n";
+    
+    // Read the line; \ at the end (without -r) joins the next one
+    char* line = NULL;
+    size_t capacity = 0;
+    char* text = NULL;
+    size_t text_length = 0;
+    int status = 0;
+    while (1) {
+        ssize_t n = read_line(&line, &capacity);
+        if (n < 0) {
+            status = 1;
+            break;
+        }
+        text = realloc(text, text_length + n + 1);
+        memcpy(text + text_length, line, n + 1);
+        text_length += n;
+        if (raw || n == 0 || line[n - 1] != '\\') break;
+        
+        // Count the backslashes: an even number ends the line
+        ssize_t slashes = 0;
+        while (slashes < n && line[n - 1 - slashes] == '\\') slashes++;
+        if (slashes % 2 == 0) break;
+        text[--text_length] = '\0';
+    }
+    free(line);
+    if (text == NULL) {
+        text = strdup("");
+    }
+    
+    // Split into fields; escaped characters never separate them
+    char* p = text;
+    for (int k = 0; names[k] != NULL; k++) {
+        while (*p != '\0' && strchr(ifs, *p) != NULL && isspace((unsigned char)*p)) p++;
+        
+        char* value = malloc(strlen(p) + 1);
+        char* out = value;
+        char* last_kept = value;   // end of the value without trailing IFS blanks
+        int last = (names[k + 1] == NULL);
+        while (*p != '\0') {
+            if (*p == '\\' && !raw && p[1] != '\0') {
+                *out++ = *++p;
+                p++;
+                last_kept = out;
+                continue;
+            }
+            if (strchr(ifs, *p) != NULL) {
+                if (!last) {
+                    p++;
+                    break;
+                }
+                if (!isspace((unsigned char)*p)) last_kept = out + 1;
+            } else {
+                last_kept = out + 1;
+            }
+            *out++ = *p++;
+        }
+        *last_kept = '\0';
+        
+        if (set_variable(names[k], value) != 0) status = 1;
+        free(value);
+    }
+    free(text);
+    return status;
+}
+
+// cd [dir | -]: with no argument go to $HOME; - goes back to $OLDPWD
+void execute_cd(char** args) {
+    char* target = args[1];
+    char previous[PATH_MAX];
+    
+    if (target == NULL) {
+        target = get_variable("HOME");
+        if (target == NULL) {
+            fprintf(stderr, "cd: HOME not set\n");
+            builtin_status = 1;
+            return;
+        }
+    } else if (strcmp(target, "-") == 0) {
+        target = get_variable("OLDPWD");
+        if (target == NULL) {
+            fprintf(stderr, "cd: OLDPWD not set\n");
+            builtin_status = 1;
+            return;
+        }
+        puts(target);
+    }
+    
+    if (getcwd(previous, sizeof(previous)) == NULL) previous[0] = '\0';
+    if (chdir(target) != 0) {
+        fprintf(stderr, "cd: %s: %s\n", target, strerror(errno));
+        builtin_status = 1;
+        return;
+    }
+    
+    char current[PATH_MAX];
+    if (previous[0] != '\0') set_variable("OLDPWD", previous);
+    if (getcwd(current, sizeof(current)) != NULL) set_variable("PWD", current);
+}
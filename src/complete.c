@@ -0,0 +1,201 @@
+#include "shell.h"
+#include <dirent.h>
+#include <sys/inotify.h>
+
+// Tab completion.
+//
+// Command names come from a sorted array of every executable on PATH plus
+// the builtins, built on the first completion and answered with a binary
+// search for the prefix. inotify watches the PATH directories; when one
+// changes (or PATH itself does) the array is rebuilt on the next Tab and
+// the command location cache is cleared with it. Words starting with $
+// complete to variable names; everything else falls back to readline's
+// filename completion.
+
+static arena_t name_arena;
+static char** names;
+static int num_names;
+static char* indexed_path;   // PATH the index was built for, NULL if stale
+static int inotify_fd = -1;
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char**)a, *(char**)b);
+}
+
+static void add_name(const char* name, int* capacity) {
+    if (num_names == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 1024;
+        names = realloc(names, *capacity * sizeof(char*));
+    }
+    names[num_names++] = arena_strdup(&name_arena, name);
+}
+
+// Add the executables in one PATH directory and watch it for changes
+static void index_directory(const char* dir, int* capacity) {
+    DIR* d = opendir(dir);
+    if (d == NULL) return;
+    
+    if (inotify_fd >= 0) {
+        inotify_add_watch(inotify_fd, dir, IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                          IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF);
+    }
+    
+    struct dirent* entry;
+    while ((entry = readdir(d)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+        if (entry->d_type != DT_REG && entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN) continue;
+        
+        // Symlinks and unknown types need a stat to rule out directories
+        if (entry->d_type != DT_REG) {
+            struct stat st;
+            if (fstatat(dirfd(d), entry->d_name, &st, 0) < 0 || !S_ISREG(st.st_mode)) continue;
+        }
+        if (faccessat(dirfd(d), entry->d_name, X_OK, 0) == 0) {
+            add_name(entry->d_name, capacity);
+        }
+    }
+    closedir(d);
+}
+
+static void build_index(const char* path) {
+    int capacity = 0;
+    
+    if (names == NULL) arena_init(&name_arena);
+    else arena_reset(&name_arena);
+    free(names);
+    names = NULL;
+    num_names = 0;
+    
+    // A fresh inotify instance drops the watches on the old directories
+    if (inotify_fd >= 0) close(inotify_fd);
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    
+    char* copy = strdup(path);
+    char* saveptr;
+    for (char* dir = strtok_r(copy, ":", &saveptr); dir != NULL; dir = strtok_r(NULL, ":", &saveptr)) {
+        index_directory(dir, &capacity);
+    }
+    free(copy);
+    
+    for (int i = 0; builtins[i].name != NULL; i++) {
+        add_name(builtins[i].name, &capacity);
+    }
+    
+    // Sort, then drop names shadowed by an earlier PATH entry
+    qsort(names, num_names, sizeof(char*), compare_names);
+    int unique = 0;
+    for (int i = 0; i < num_names; i++) {
+        if (unique == 0 || strcmp(names[unique - 1], names[i]) != 0) names[unique++] = names[i];
+    }
+    num_names = unique;
+    
+    free(indexed_path);
+    indexed_path = strdup(path);
+}
+
+// Rebuild the index if PATH or one of its directories changed
+static void refresh_index() {
+    char* path = get_variable("PATH");
+    if (path == NULL) path = "/usr/local/bin:/usr/bin:/bin";
+    
+    if (inotify_fd >= 0) {
+        char buffer[4096];
+        ssize_t n = read(inotify_fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            while (read(inotify_fd, buffer, sizeof(buffer)) > 0);
+            free(indexed_path);
+            indexed_path = NULL;
+            clear_command_hash();
+        }
+    }
+    
+    if (indexed_path == NULL || strcmp(indexed_path, path) != 0) build_index(path);
+}
+
+// Commands starting with prefix: *matches points at the first of them in
+// the sorted index, the return value is how many there are
+int complete_commands(const char* prefix, char*** matches) {
+    refresh_index();
+    
+    size_t length = strlen(prefix);
+    int low = 0, high = num_names;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (strcmp(names[mid], prefix) < 0) low = mid + 1;
+        else high = mid;
+    }
+    
+    int end = low;
+    while (end < num_names && strncmp(names[end], prefix, length) == 0) end++;
+    *matches = names + low;
+    return end - low;
+}
+
+static char** command_matches;
+static int num_command_matches;
+
+static char* command_generator(const char* text, int state) {
+    if (state == 0) num_command_matches = complete_commands(text, &command_matches);
+    if (state >= num_command_matches) return NULL;
+    return strdup(command_matches[state]);
+}
+
+// Walks variable_list (which holds the imported environment too) for
+// names after the $
+static int variable_position;
+
+static char* variable_generator(const char* text, int state) {
+    const char* prefix = text + 1;
+    size_t length = strlen(prefix);
+    
+    if (state == 0) variable_position = 0;
+    
+    while (variable_position < variable_count) {
+        variable_t* var = &variable_list[variable_position++];
+        if (var->value != NULL && strncmp(var->name, prefix, length) == 0) {
+            char* match = malloc(strlen(var->name) + 2);
+            sprintf(match, "$%s", var->name);
+            return match;
+        }
+    }
+    return NULL;
+}
+
+// Whether the word at start is in command position: first on the line or
+// after an operator or a keyword that starts a command
+static int command_position(int start) {
+    static char* keywords[] = {"if", "then", "else", "elif", "do", "while", "until", "time", "!", NULL};
+    int i = start;
+    
+    while (i > 0 && (rl_line_buffer[i - 1] == ' ' || rl_line_buffer[i - 1] == '\t')) i--;
+    if (i == 0 || strchr("|;&(", rl_line_buffer[i - 1]) != NULL) return 1;
+    
+    int word_end = i;
+    while (i > 0 && rl_line_buffer[i - 1] != ' ' && rl_line_buffer[i - 1] != '\t') i--;
+    for (int k = 0; keywords[k] != NULL; k++) {
+        if ((int)strlen(keywords[k]) == word_end - i && strncmp(rl_line_buffer + i, keywords[k], word_end - i) == 0) {
+            return command_position(i);
+        }
+    }
+    return 0;
+}
+
+static char** shell_completion(const char* text, int start, int end) {
+    if (text[0] == '$') {
+        rl_attempted_completion_over = 1;
+        return rl_completion_matches(text, variable_generator);
+    }
+    if (strchr(text, '/') == NULL && command_position(start)) {
+        char** matches = rl_completion_matches(text, command_generator);
+        if (matches != NULL) rl_attempted_completion_over = 1;
+        return matches;
+    }
+    return NULL;
+}
+
+void init_completion() {
+    rl_attempted_completion_function = shell_completion;
+    
+    // Keep $ with the word so variable names can be completed
+    rl_special_prefixes = "$";
+}
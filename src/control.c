@@ -1,183 +1,252 @@
 #include "shell.h"
 
-// Check if the next command is a control structure
-int is_control_structure(char* cmdline) {
-    // For now, we'll check by reading the first line
-    // In a more advanced implementation, we'd parse the cmdline
-    char* first_line = readline(""); // Read without prompt to check
-    if (first_line == NULL) return 0;
-    
-    int is_control = 0;
-    // Trim whitespace
-    char* trimmed = first_line;
-    while (*trimmed == ' ' || *trimmed == '\t') trimmed++;
-    
-    if (strncmp(trimmed, "if", 2) == 0 && (trimmed[2] == ' ' || trimmed[2] == '\t' || trimmed[2] == '\0')) {
-        is_control = 1;
-    }
-    
-    // Put the line back for parsing
-    if (is_control) {
-        rl_replace_line(first_line, 0);
-        rl_redisplay();
-    }
-    
-    free(first_line);
-    return is_control;
-}
+// Loops being run, and the levels a pending break or continue still has
+// to leave. While either count is set every list stops early, so the
+// command unwinds to the loop it applies to.
+static int loop_depth = 0;
+static int breaking = 0;
+static int continuing = 0;
 
-// Parse if-then-else-fi structure
-if_block_t* parse_if_structure() {
-    if_block_t* if_block = (if_block_t*)malloc(sizeof(if_block_t));
-    if_block->then_count = 0;
-    if_block->else_count = 0;
-    if_block->has_else = 0;
-    
-    char* line;
-    int in_then_block = 0;
-    int in_else_block = 0;
-    int block_ended = 0;
-    
-    // Read the if line
-    line = readline("if> ");
-    if (line == NULL) {
-        free(if_block);
-        return NULL;
-    }
-    
-    // Extract condition command (remove "if" keyword)
-    char* condition = line;
-    while (*condition == ' ' || *condition == '\t') condition++;
-    condition += 2; // Skip "if"
-    while (*condition == ' ' || *condition == '\t') condition++;
-    
-    if_block->condition_command = strdup(condition);
-    free(line);
-    
-    // Read then block
-    in_then_block = 1;
-    while (in_then_block && !block_ended) {
-        line = readline("then> ");
-        if (line == NULL) break;
-        
-        // Trim whitespace
-        char* trimmed = line;
-        while (*trimmed == ' ' || *trimmed == '\t') trimmed++;
+// Read the bodies of the << and <<- here-documents on cmdline: input lines
+// are appended to it until every delimiter has been seen, so the parser
+// finds each body after the line. Returns the (reallocated) line.
+char* read_here_documents(char* cmdline) {
+    if (strstr(cmdline, "<<") == NULL) return cmdline;
+    
+    // The lexer terminates words in place, so scan a copy
+    char* copy = strdup(cmdline);
+    lexer_t lexer;
+    token_t token;
+    lexer_init(&lexer, copy);
+    
+    for (lex_next(&lexer, &token); token.type != TOK_END && token.type != TOK_ERROR; lex_next(&lexer, &token)) {
+        if (token.type != TOK_DLESS && token.type != TOK_DLESSDASH) continue;
+        int strip_tabs = (token.type == TOK_DLESSDASH);
+        lex_next(&lexer, &token);
+        if (token.type != TOK_WORD) break;
+        char* delimiter = here_delimiter(token.text);
         
-        if (strcmp(trimmed, "else") == 0) {
-            in_then_block = 0;
-            in_else_block = 1;
-            if_block->has_else = 1;
-        } else if (strcmp(trimmed, "fi") == 0) {
-            in_then_block = 0;
-            block_ended = 1;
-        } else if (strlen(trimmed) > 0) {
-            if (if_block->then_count < MAX_COMMANDS) {
-                if_block->then_commands[if_block->then_count++] = strdup(trimmed);
+        while (1) {
+            char* line = input_read_line("> ");
+            if (line == NULL) break;
+            
+            size_t len = strlen(cmdline);
+            cmdline = realloc(cmdline, len + strlen(line) + 2);
+            cmdline[len] = '\n';
+            strcpy(cmdline + len + 1, line);
+            
+            char* text = line;
+            if (strip_tabs) {
+                while (*text == '\t') text++;
             }
+            int done = strcmp(text, delimiter) == 0;
+            free(line);
+            if (done) break;
         }
-        free(line);
     }
-    
-    // Read else block if present
-    while (in_else_block && !block_ended) {
-        line = readline("else> ");
-        if (line == NULL) break;
+    free(copy);
+    return cmdline;
+}
+
+// Read a complete command starting with first_line and compile it into
+// line_arena, reading further lines while an if, a loop or a here-document
+// is still open. *text gets the source the tree's words point into; free
+// it once the tree has been released. Returns NULL after a syntax error.
+node_t* read_program(char* first_line, char** text) {
+    char* source = strdup(first_line);
+    node_t* root = NULL;
+    
+    while (1) {
+        // The parser terminates words in place, so parse a copy
+        *text = strdup(source);
         
-        // Trim whitespace
-        char* trimmed = line;
-        while (*trimmed == ' ' || *trimmed == '\t') trimmed++;
+        int incomplete = 0;
+        arena_mark_t mark = arena_mark(&line_arena);
+        root = parse_program(&line_arena, *text, &incomplete);
+        if (root != NULL || !incomplete) break;
         
-        if (strcmp(trimmed, "fi") == 0) {
-            in_else_block = 0;
-            block_ended = 1;
-        } else if (strlen(trimmed) > 0) {
-            if (if_block->else_count < MAX_COMMANDS) {
-                if_block->else_commands[if_block->else_count++] = strdup(trimmed);
-            }
+        arena_release(&line_arena, mark);
+        free(*text);
+        *text = NULL;
+        
+        char* line = input_read_line("> ");
+        if (line == NULL) {
+            fprintf(stderr, "myshell: syntax error: unexpected end of file\n");
+            break;
         }
+        
+        size_t len = strlen(source);
+        source = realloc(source, len + strlen(line) + 2);
+        source[len] = '\n';
+        strcpy(source + len + 1, line);
         free(line);
     }
     
-    // If we didn't reach fi, read until we find it
-    while (!block_ended) {
-        line = readline("> ");
-        if (line == NULL) break;
-        
-        // Trim whitespace
-        char* trimmed = line;
-        while (*trimmed == ' ' || *trimmed == '\t') trimmed++;
-        
-        if (strcmp(trimmed, "fi") == 0) {
-            block_ended = 1;
+    free(source);
+    return root;
+}
+
+// Copy a tree pipeline into line_arena so expansion can rewrite the
+// argument arrays without touching the tree. Only pointers are copied.
+static pipeline_t* copy_pipeline(pipeline_t* pipeline) {
+    pipeline_t* copy = arena_alloc(&line_arena, sizeof(pipeline_t));
+    *copy = *pipeline;
+    copy->commands = arena_alloc(&line_arena, pipeline->num_commands * sizeof(command_t));
+    
+    for (int i = 0; i < pipeline->num_commands; i++) {
+        command_t* cmd = &copy->commands[i];
+        *cmd = pipeline->commands[i];
+        cmd->args = arena_alloc(&line_arena, (cmd->argc + 1) * sizeof(char*));
+        memcpy(cmd->args, pipeline->commands[i].args, (cmd->argc + 1) * sizeof(char*));
+    }
+    return copy;
+}
+
+// break [n] / continue [n]: leave, or go on with the next iteration of,
+// the nth enclosing loop (default 1)
+static int loop_levels(char** args, int* levels) {
+    int n = 1;
+    
+    if (args[1] != NULL) {
+        char* end;
+        n = strtol(args[1], &end, 10);
+        if (*end != '\0' || n < 1) {
+            fprintf(stderr, "%s: %s: loop count out of range\n", args[0], args[1]);
+            return 1;
         }
-        free(line);
     }
-    
-    return if_block;
+    if (loop_depth == 0) {
+        fprintf(stderr, "%s: only meaningful in a loop\n", args[0]);
+        return 0;
+    }
+    *levels = n < loop_depth ? n : loop_depth;
+    return 0;
 }
 
-// Execute a condition command and return its exit status
-int execute_condition(char* condition) {
-    if (condition == NULL || strlen(condition) == 0) return 1; // Empty condition fails
-    
-    pipeline_t* pipeline = parse_command_line(condition);
-    if (pipeline == NULL || pipeline->num_commands == 0) return 1;
+int execute_break(char** args) {
+    return loop_levels(args, &breaking);
+}
+
+int execute_continue(char** args) {
+    return loop_levels(args, &continuing);
+}
+
+// After one run of a loop body: whether the loop should stop. A pending
+// break or continue for an outer loop ends this one too; so does a command
+// killed by Ctrl-C, as the shell itself ignores SIGINT.
+static int loop_done(int status) {
+    if (breaking > 0) {
+        breaking--;
+        return 1;
+    }
+    if (continuing > 0) {
+        continuing--;
+        if (continuing > 0) return 1;
+    }
+    return status == 128 + SIGINT;
+}
+
+// for NAME in WORDS: the words are expanded (with splitting and globbing)
+// once when the loop starts, then each one is assigned in turn
+static int execute_for(node_t* node) {
+    arena_mark_t mark = arena_mark(&line_arena);
+    int count = 0;
+    while (node->words[count] != NULL) count++;
+    
+    char** words = arena_alloc(&line_arena, (count + 1) * sizeof(char*));
+    memcpy(words, node->words, (count + 1) * sizeof(char*));
+    expansion_error = 0;
+    expand_variables(&words);
+    if (expansion_error) {
+        arena_release(&line_arena, mark);
+        return 1;
+    }
     
     int status = 0;
-    pid_t pid = fork();
-    
-    if (pid == 0) {
-        // Child process - execute the condition
-        if (pipeline->num_commands == 1) {
-            execute_single_command(&pipeline->commands[0]);
-        } else {
-            execute_pipeline(pipeline);
+    loop_depth++;
+    for (int i = 0; words[i] != NULL; i++) {
+        if (set_variable(node->name, words[i]) != 0) {
+            status = 1;
+            break;
         }
-        exit(0);
-    } else {
-        // Parent process - wait for condition result
-        waitpid(pid, &status, 0);
-        free_pipeline(pipeline);
-        
-        if (WIFEXITED(status)) {
-            return WEXITSTATUS(status); // Return the exit code
-        } else {
-            return 1; // If process was killed, consider it failure
+        status = execute_node(node->body);
+        if (loop_done(status)) break;
+    }
+    loop_depth--;
+    arena_release(&line_arena, mark);
+    return status;
+}
+
+// while/until: the condition and body trees are walked again on every
+// iteration; only expansion is redone, never parsing
+static int execute_while(node_t* node) {
+    int status = 0;
+    int until = (node->type == NODE_UNTIL);
+    
+    loop_depth++;
+    while (1) {
+        // Each pass tests the files afresh
+        test_cache_clear();
+        int cond = execute_node(node->cond);
+        if (breaking > 0 || continuing > 0) {
+            // break or continue inside the condition itself
+            if (loop_done(cond)) break;
+            continue;
         }
+        if ((cond == 0) == until || cond == 128 + SIGINT) break;
+        
+        status = execute_node(node->body);
+        if (loop_done(status)) break;
     }
+    loop_depth--;
+    return status;
 }
 
-// Execute if-then-else block
-int execute_if_block(if_block_t* if_block) {
-    if (if_block == NULL) return -1;
+// Walk a syntax tree and return the exit status of the last command run
+int execute_node(node_t* node) {
+    if (node == NULL) return 0;
     
-    // Execute the condition
-    int condition_result = execute_condition(if_block->condition_command);
-    
-    if (condition_result == 0) {
-        // Condition succeeded - execute then block
-        for (int i = 0; i < if_block->then_count; i++) {
-            if (if_block->then_commands[i] != NULL) {
-                pipeline_t* pipeline = parse_command_line(if_block->then_commands[i]);
-                if (pipeline != NULL) {
-                    execute_pipeline(pipeline);
-                    free_pipeline(pipeline);
-                }
-            }
+    int status = 0;
+    switch (node->type) {
+        case NODE_PIPELINE: {
+            arena_mark_t mark = arena_mark(&line_arena);
+            status = run_pipeline(copy_pipeline(node->pipeline));
+            arena_release(&line_arena, mark);
+            break;
         }
-    } else if (if_block->has_else) {
-        // Condition failed and else block exists - execute else block
-        for (int i = 0; i < if_block->else_count; i++) {
-            if (if_block->else_commands[i] != NULL) {
-                pipeline_t* pipeline = parse_command_line(if_block->else_commands[i]);
-                if (pipeline != NULL) {
-                    execute_pipeline(pipeline);
-                    free_pipeline(pipeline);
-                }
+        case NODE_LIST:
+            for (node_t* child = node->body; child != NULL; child = child->next) {
+                status = execute_node(child);
+                if (breaking > 0 || continuing > 0) break;
             }
+            break;
+        case NODE_AND:
+            status = execute_node(node->cond);
+            if (status == 0 && breaking == 0 && continuing == 0) status = execute_node(node->other);
+            break;
+        case NODE_OR:
+            status = execute_node(node->cond);
+            if (status != 0 && breaking == 0 && continuing == 0) status = execute_node(node->other);
+            break;
+        case NODE_IF: {
+            int cond = execute_node(node->cond);
+            if (breaking > 0 || continuing > 0) {
+                status = cond;
+            } else if (cond == 0) {
+                status = execute_node(node->body);
+            } else if (node->other != NULL) {
+                status = execute_node(node->other);
+            }
+            break;
         }
+        case NODE_WHILE:
+        case NODE_UNTIL:
+            // A loop's own status, not its condition's, is what $? sees next
+            status = last_status = execute_while(node);
+            break;
+        case NODE_FOR:
+            status = last_status = execute_for(node);
+            break;
     }
-    
-    return 0;
+    return status;
 }
@@ -0,0 +1,134 @@
+#include "shell.h"
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+
+// Interactive input as an event loop.
+//
+// readline is driven through its callback interface while epoll waits on
+// the terminal, a signalfd carrying SIGCHLD and a timerfd for TMOUT. A
+// background job is reaped and reported the moment it finishes, with the
+// prompt and the partly typed line redrawn underneath, instead of being
+// polled for before every prompt.
+//
+// SIGCHLD stays blocked in the shell so it queues on the signalfd;
+// children are started with the mask the shell had before.
+
+static int epoll_fd = -1;
+static int signal_fd = -1;
+static int timer_fd = -1;
+static sigset_t child_mask;
+
+// Set by line_handler() once readline has a complete line (or EOF)
+static char* line_read;
+static int line_done;
+
+static int watch(int fd) {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+// Set up the descriptors; on failure input falls back to plain readline()
+int init_events() {
+    sigset_t chld;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    signal_fd = signalfd(-1, &chld, SFD_NONBLOCK | SFD_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    
+    if (epoll_fd < 0 || signal_fd < 0 || timer_fd < 0 ||
+        watch(STDIN_FILENO) < 0 || watch(signal_fd) < 0 || watch(timer_fd) < 0) {
+        perror("myshell: event loop");
+        if (epoll_fd >= 0) close(epoll_fd);
+        if (signal_fd >= 0) close(signal_fd);
+        if (timer_fd >= 0) close(timer_fd);
+        epoll_fd = signal_fd = timer_fd = -1;
+        return -1;
+    }
+    
+    sigprocmask(SIG_BLOCK, &chld, &child_mask);
+    return 0;
+}
+
+// The signal mask children should start with, if the loop changed ours
+int events_child_mask(sigset_t* mask) {
+    if (epoll_fd < 0) return 0;
+    *mask = child_mask;
+    return 1;
+}
+
+static void line_handler(char* line) {
+    // Removing the handler here stops readline from printing a fresh
+    // prompt before the command has even run
+    rl_callback_handler_remove();
+    line_read = line;
+    line_done = 1;
+}
+
+// Arm the timer for TMOUT seconds, or disarm it when TMOUT is unset
+static void arm_timeout() {
+    char* value = get_variable("TMOUT");
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    
+    if (value != NULL && atol(value) > 0) spec.it_value.tv_sec = atol(value);
+    timerfd_settime(timer_fd, 0, &spec, NULL);
+}
+
+// Reap what SIGCHLD announced and print any job reports above the prompt
+static void child_event() {
+    struct signalfd_siginfo info[16];
+    while (read(signal_fd, info, sizeof(info)) > 0);
+    
+    if (cleanup_zombies() == 0) return;
+    
+    rl_clear_visible_line();
+    update_jobs();
+    fflush(stdout);
+    rl_on_new_line();
+    rl_redisplay();
+}
+
+// Read one line at prompt; NULL at end of input or after TMOUT expired
+char* event_read_line(const char* prompt) {
+    if (epoll_fd < 0) return readline(prompt);
+    
+    line_read = NULL;
+    line_done = 0;
+    rl_callback_handler_install(prompt, line_handler);
+    arm_timeout();
+    
+    while (!line_done) {
+        struct epoll_event events[3];
+        int n = epoll_wait(epoll_fd, events, 3, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            rl_callback_handler_remove();
+            break;
+        }
+        
+        for (int i = 0; i < n && !line_done; i++) {
+            int fd = events[i].data.fd;
+            if (fd == STDIN_FILENO) {
+                rl_callback_read_char();
+            } else if (fd == signal_fd) {
+                child_event();
+            } else if (fd == timer_fd) {
+                rl_callback_handler_remove();
+                printf("\ntimed out waiting for input: auto-logout\n");
+                line_done = 1;
+            }
+        }
+    }
+    
+    struct itimerspec off;
+    memset(&off, 0, sizeof(off));
+    timerfd_settime(timer_fd, 0, &off, NULL);
+    return line_read;
+}
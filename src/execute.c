@@ -1,21 +1,681 @@
 #include "shell.h"
+#include <errno.h>
+#include <limits.h>
+#include <sys/mman.h>
 
-// This file is now mostly redundant as functionality moved to shell.c
-// Keeping it for backward compatibility
+// Process launching for single commands and pipelines.
+//
+// External commands are started with posix_spawn(), which glibc implements
+// with clone(CLONE_VM|CLONE_VFORK): the child borrows the shell's address
+// space until it execs, so launch cost does not grow with the shell's RSS
+// the way fork() does. Redirections and pipes are opened in the shell and
+// handed to the child as dup2 file actions. A lone builtin or compound
+// command runs in the shell, redirections included (see run_in_shell());
+// fork() is only used when one has to run in its own process (a stage of
+// a pipeline).
+//
+// Pipes are sized from the PIPESIZE variable (bytes, or with a K/M suffix)
+// through F_SETPIPE_SZ; larger pipes mean fewer context switches between
+// stages moving bulk data. A command with several output targets
+// (cmd > a > b) writes into a pipe drained by a small forked helper that
+// copies the data to every target with tee(2) and splice(2), so the bytes
+// never pass through user space.
+
+// Resource usage of the children reaped by launch(), read by the time keyword
+static struct rusage launch_usage;
+
+// Exit status of the last pipeline run, for $?
+int last_status = 0;
 
 int execute(char* arglist[]) {
     if (arglist == NULL || arglist[0] == NULL) return -1;
     
     command_t cmd;
-    int i;
-    for (i = 0; arglist[i] != NULL && i < MAXARGS - 1; i++) {
-        cmd.args[i] = arglist[i];
-    }
-    cmd.args[i] = NULL;
+    cmd.args = arglist;
+    for (cmd.argc = 0; arglist[cmd.argc] != NULL; cmd.argc++);
     cmd.input_file = NULL;
     cmd.output_file = NULL;
     cmd.append_output = 0;
+    cmd.extra_outputs = NULL;
+    cmd.num_extra_outputs = 0;
+    cmd.here_text = NULL;
+    cmd.here_kind = HERE_NONE;
     cmd.background = 0;
     
     return execute_single_command(&cmd);
 }
+
+static int open_output(char* file, int append) {
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+    return open(file, flags, 0644);
+}
+
+// A descriptor to read text from: a pipe when the text fits in one atomic
+// write, an anonymous memfd otherwise. Nothing touches the filesystem.
+static int open_here_text(const char* text) {
+    size_t length = strlen(text);
+    
+    if (length <= PIPE_BUF) {
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) < 0) return -1;
+        if (length > 0 && write(fds[1], text, length) < 0) {
+            close(fds[0]);
+            fds[0] = -1;
+        }
+        close(fds[1]);
+        return fds[0];
+    }
+    
+    int fd = memfd_create("here-document", MFD_CLOEXEC);
+    if (fd < 0) return -1;
+    while (length > 0) {
+        ssize_t n = write(fd, text, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            return -1;
+        }
+        text += n;
+        length -= n;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+// Open a command's < > >> targets (and here-document) in the shell.
+// On success *in_fd / *out_fd hold the opened descriptors, or -1 when that
+// side is not redirected. The descriptors are close-on-exec; the child only
+// sees them through the dup2 onto 0/1.
+int setup_redirection(command_t* cmd, int* in_fd, int* out_fd) {
+    *in_fd = -1;
+    *out_fd = -1;
+    
+    if (cmd->here_text != NULL) {
+        *in_fd = open_here_text(cmd->here_text);
+        if (*in_fd < 0) {
+            perror("here-document");
+            return -1;
+        }
+    } else if (cmd->input_file != NULL) {
+        *in_fd = open(cmd->input_file, O_RDONLY | O_CLOEXEC);
+        if (*in_fd < 0) {
+            perror(cmd->input_file);
+            return -1;
+        }
+    }
+    
+    if (cmd->output_file != NULL) {
+        *out_fd = open_output(cmd->output_file, cmd->append_output);
+        if (*out_fd < 0) {
+            perror(cmd->output_file);
+            if (*in_fd >= 0) close(*in_fd);
+            *in_fd = -1;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Requested pipe capacity from PIPESIZE, or 0 to keep the kernel default
+static int pipe_size_setting() {
+    char* value = get_variable("PIPESIZE");
+    if (value == NULL || value[0] == '\0') return 0;
+    
+    char* end;
+    long size = strtol(value, &end, 10);
+    if (*end == 'k' || *end == 'K') {
+        size *= 1024;
+        end++;
+    } else if (*end == 'm' || *end == 'M') {
+        size *= 1024 * 1024;
+        end++;
+    }
+    if (*end != '\0' || size <= 0 || size > (1L << 30)) return 0;
+    return (int)size;
+}
+
+// The kernel rounds the size up to a power of two pages and refuses sizes
+// above /proc/sys/fs/pipe-max-size for unprivileged users; either way the
+// pipe stays usable, so failures are ignored.
+static void size_pipe(int fd, int size) {
+    if (size > 0) fcntl(fd, F_SETPIPE_SZ, size);
+}
+
+// Create the num_commands - 1 pipes joining the stages of a pipeline
+int setup_pipes(pipeline_t* pipeline, int pipefds[][2]) {
+    int size = pipe_size_setting();
+    
+    for (int i = 0; i < pipeline->num_commands - 1; i++) {
+        if (pipe2(pipefds[i], O_CLOEXEC) < 0) {
+            perror("pipe");
+            for (int j = 0; j < i; j++) {
+                close(pipefds[j][0]);
+                close(pipefds[j][1]);
+            }
+            return -1;
+        }
+        size_pipe(pipefds[i][1], size);
+    }
+    return 0;
+}
+
+// Open the targets after the first of cmd > a > b into fds[1..].
+// Returns -1 (with everything closed again) if one cannot be opened.
+static int open_extra_outputs(command_t* cmd, int* fds) {
+    for (int i = 0; i < cmd->num_extra_outputs; i++) {
+        fds[i + 1] = open_output(cmd->extra_outputs[i].file, cmd->extra_outputs[i].append);
+        if (fds[i + 1] < 0) {
+            perror(cmd->extra_outputs[i].file);
+            for (int j = 1; j <= i; j++) close(fds[j]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Move exactly len bytes from the pipe from_fd to to_fd. splice() can
+// refuse some targets (O_APPEND files on older kernels, for one); those
+// fall back to a plain read/write copy.
+static int drain_pipe(int from_fd, int to_fd, size_t len) {
+    char buffer[65536];
+    
+    while (len > 0) {
+        ssize_t moved = splice(from_fd, NULL, to_fd, NULL, len, SPLICE_F_MOVE);
+        if (moved < 0 && errno == EINVAL) {
+            moved = read(from_fd, buffer, len < sizeof(buffer) ? len : sizeof(buffer));
+            if (moved > 0 && write(to_fd, buffer, moved) != moved) return -1;
+        }
+        if (moved < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (moved == 0) return -1;
+        len -= moved;
+    }
+    return 0;
+}
+
+// Body of the fan-out helper: copy everything arriving on in_fd to each
+// of out_fds[0..n-1]. Every round tee()s the data waiting in the input
+// pipe into one private pipe per extra target without consuming it, then
+// splices those copies out and finally splices the input itself to the
+// last target. The private pipes are as large as the input pipe and
+// empty at the start of a round, so each tee() copies the whole round.
+static void tee_outputs(int in_fd, int* out_fds, int n) {
+    int copies[n - 1][2];
+    int size = fcntl(in_fd, F_GETPIPE_SZ);
+    
+    for (int i = 0; i < n - 1; i++) {
+        if (pipe(copies[i]) < 0) {
+            perror("pipe");
+            return;
+        }
+        size_pipe(copies[i][1], size);
+    }
+    
+    while (1) {
+        ssize_t len = tee(in_fd, copies[0][1], INT_MAX, 0);
+        if (len < 0 && errno == EINTR) continue;
+        if (len < 0) {
+            perror("tee");
+            return;
+        }
+        if (len == 0) return; // writer finished
+        
+        for (int i = 1; i < n - 1; i++) {
+            if (tee(in_fd, copies[i][1], len, 0) != len) {
+                perror("tee");
+                return;
+            }
+        }
+        for (int i = 0; i < n - 1; i++) {
+            if (drain_pipe(copies[i][0], out_fds[i], len) < 0) {
+                perror("splice");
+                return;
+            }
+        }
+        if (drain_pipe(in_fd, out_fds[n - 1], len) < 0) {
+            perror("splice");
+            return;
+        }
+    }
+}
+
+// In a forked child, drop the pipeline's pipe ends once the ones it uses
+// are on 0/1. Unlike an exec'd child it keeps close-on-exec descriptors,
+// and a stray write end would keep a reader from ever seeing EOF.
+static void close_pipes(int pipefds[][2], int num_pipes) {
+    for (int i = 0; i < num_pipes; i++) {
+        close(pipefds[i][0]);
+        close(pipefds[i][1]);
+    }
+}
+
+// Put a forked child into the job's process group (a new one led by the
+// child when *pgid is still 0). Both parent and child call this, so the
+// group exists whichever of them runs first.
+static void join_job_group(pid_t pid, pid_t* pgid) {
+    if (!job_control) return;
+    
+    pid_t group = *pgid ? *pgid : pid;
+    setpgid(pid, group);
+    *pgid = group;
+}
+
+// Fork the fan-out helper reading fan[0]. It drops every other pipe end
+// first.
+static pid_t start_tee(int fan[2], int* out_fds, int n, int pipefds[][2], int num_pipes, pid_t pgid) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    shell_stats.forks++;
+    join_job_group(pid ? pid : getpid(), &pgid);
+    if (pid == 0) {
+        restore_job_signals();
+        close(fan[1]);
+        close_pipes(pipefds, num_pipes);
+        tee_outputs(fan[0], out_fds, n);
+        _exit(0);
+    }
+    return pid;
+}
+
+// Start one stage with stdin/stdout wired to in_fd/out_fd (-1 = inherit).
+// With job control the stage joins process group *pgid, or starts it and
+// stores its pid there. pipefds are the pipeline's pipes, which a forked
+// builtin must close. Returns the child's pid, or minus the status to
+// report if nothing was started (see spawn_external()).
+static pid_t spawn_command(command_t* cmd, int in_fd, int out_fd, pid_t* pgid, int pipefds[][2], int num_pipes) {
+    pid_t pid;
+    
+    if (cmd->compound != NULL || is_builtin(cmd->args[0])) {
+        // Builtins and compound commands have no binary to exec, so they
+        // need a real fork. Flush first so the child does not repeat
+        // buffered output.
+        fflush(stdout);
+        pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return -1;
+        }
+        shell_stats.forks++;
+        join_job_group(pid ? pid : getpid(), pgid);
+        if (pid == 0) {
+            restore_job_signals();
+            if (in_fd >= 0) dup2(in_fd, STDIN_FILENO);
+            if (out_fd >= 0) dup2(out_fd, STDOUT_FILENO);
+            close_pipes(pipefds, num_pipes);
+            if (cmd->compound != NULL) {
+                // Commands inside stay in this stage's process group
+                job_control = 0;
+                int status = execute_node(cmd->compound);
+                fflush(stdout);
+                _exit(status);
+            }
+            handle_builtin(cmd->args);
+            fflush(stdout);
+            _exit(builtin_status);
+        }
+        return pid;
+    }
+    return spawn_external(cmd->args, in_fd, out_fd, pgid);
+}
+
+// posix_spawn args[0] from PATH with stdin/stdout wired to in_fd/out_fd
+// (-1 = inherit). With job control and a non-NULL pgid the process joins
+// group *pgid, or starts it and stores its pid there; a NULL pgid keeps
+// it in the shell's group. Returns the pid, or if nothing was started
+// minus the status to report for it: 127 when the command does not exist,
+// 126 when it cannot be executed, 1 for any other failure.
+pid_t spawn_external(char** args, int in_fd, int out_fd, pid_t* pgid) {
+    pid_t pid;
+    char* path = lookup_command(args[0]);
+    if (path == NULL) {
+        fprintf(stderr, "%s: command not found\n", args[0]);
+        return -127;
+    }
+    
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (in_fd >= 0) posix_spawn_file_actions_adddup2(&actions, in_fd, STDIN_FILENO);
+    if (out_fd >= 0) posix_spawn_file_actions_adddup2(&actions, out_fd, STDOUT_FILENO);
+    
+    // Job control: join the pipeline's group and get back the signals the
+    // interactive shell ignores
+    posix_spawnattr_t attr;
+    sigset_t defaults, mask;
+    short flags = 0;
+    posix_spawnattr_init(&attr);
+    if (job_control) {
+        job_control_signals(&defaults);
+        flags |= POSIX_SPAWN_SETSIGDEF;
+        posix_spawnattr_setsigdefault(&attr, &defaults);
+        if (pgid != NULL) {
+            flags |= POSIX_SPAWN_SETPGROUP;
+            posix_spawnattr_setpgroup(&attr, *pgid);
+        }
+    }
+    // The event loop keeps SIGCHLD blocked; the child must not inherit that
+    if (events_child_mask(&mask)) {
+        flags |= POSIX_SPAWN_SETSIGMASK;
+        posix_spawnattr_setsigmask(&attr, &mask);
+    }
+    posix_spawnattr_setflags(&attr, flags);
+    
+    int err = posix_spawn(&pid, path, &actions, &attr, args, shell_environment());
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    
+    if (err != 0) {
+        fprintf(stderr, "%s: %s\n", args[0], strerror(err));
+        if (err == ENOENT) return -127;
+        return (err == EACCES || err == ENOEXEC || err == EISDIR) ? -126 : -1;
+    }
+    if (job_control && pgid != NULL && *pgid == 0) *pgid = pid;
+    shell_stats.execs++;
+    return pid;
+}
+
+// The command text shown by jobs, built into buffer. Compound commands
+// are only named by their keywords.
+static char* job_text(command_t* commands, int n, char* buffer, size_t size) {
+    static char* compound_text[] = {[NODE_IF] = "if ... fi", [NODE_WHILE] = "while ... done",
+                                    [NODE_UNTIL] = "until ... done", [NODE_FOR] = "for ... done"};
+    
+    buffer[0] = '\0';
+    for (int i = 0; i < n; i++) {
+        if (commands[i].compound != NULL) {
+            if (buffer[0] != '\0') strncat(buffer, " ", size - strlen(buffer) - 1);
+            strncat(buffer, compound_text[commands[i].compound->type], size - strlen(buffer) - 1);
+        }
+        for (int j = 0; commands[i].args[j] != NULL; j++) {
+            if (buffer[0] != '\0') strncat(buffer, " ", size - strlen(buffer) - 1);
+            strncat(buffer, commands[i].args[j], size - strlen(buffer) - 1);
+        }
+        if (i < n - 1) strncat(buffer, " |", size - strlen(buffer) - 1);
+    }
+    return buffer;
+}
+
+// Start commands[0..n-1] connected by pipes and return them as a job
+// that is not in the job table yet
+job_t* start_pipeline(command_t* commands, int n) {
+    pipeline_t view;
+    view.num_commands = n;
+    int pipefds[n > 1 ? n - 1 : 1][2];
+    pid_t pids[n];
+    pid_t helpers[n];
+    pid_t pgid = 0; // process group of the job, once its first process exists
+    
+    if (setup_pipes(&view, pipefds) < 0) return NULL;
+    
+    // Whatever the shell printed so far must come before the job's output
+    fflush(stdout);
+    
+    for (int i = 0; i < n; i++) {
+        command_t* cmd = &commands[i];
+        int in_fd = (i > 0) ? pipefds[i - 1][0] : -1;
+        int out_fd = (i < n - 1) ? pipefds[i][1] : -1;
+        int redir_in, redir_out;
+        
+        pids[i] = -1;
+        helpers[i] = -1;
+        if (setup_redirection(cmd, &redir_in, &redir_out) < 0) continue;
+        if (cmd->args[0] == NULL && cmd->compound == NULL) {
+            // Only redirections: the files are created, nothing runs
+            if (redir_in >= 0) close(redir_in);
+            if (redir_out >= 0) close(redir_out);
+            pids[i] = 0;
+            continue;
+        }
+        
+        if (redir_in >= 0) in_fd = redir_in;
+        if (redir_out >= 0) out_fd = redir_out;
+        
+        if (cmd->num_extra_outputs > 0) {
+            // cmd > a > b: the command writes into fan[1] and a helper
+            // copies fan[0] to every target
+            int outputs = cmd->num_extra_outputs + 1;
+            int out_fds[outputs];
+            int fan[2];
+            
+            out_fds[0] = redir_out;
+            if (open_extra_outputs(cmd, out_fds) == 0 && pipe2(fan, O_CLOEXEC) == 0) {
+                size_pipe(fan[1], pipe_size_setting());
+                pids[i] = spawn_command(cmd, in_fd, fan[1], &pgid, pipefds, n - 1);
+                if (pids[i] > 0) helpers[i] = start_tee(fan, out_fds, outputs, pipefds, n - 1, pgid);
+                close(fan[0]);
+                close(fan[1]);
+                for (int j = 1; j < outputs; j++) close(out_fds[j]);
+            }
+        } else {
+            pids[i] = spawn_command(cmd, in_fd, out_fd, &pgid, pipefds, n - 1);
+        }
+        
+        if (redir_in >= 0) close(redir_in);
+        if (redir_out >= 0) close(redir_out);
+    }
+    
+    // The children hold their own copies of the pipe ends now
+    for (int i = 0; i < n - 1; i++) {
+        close(pipefds[i][0]);
+        close(pipefds[i][1]);
+    }
+    
+    // Stages and helpers in launch order; the job waits for them in turn
+    pid_t members[2 * n];
+    int num_members = 0;
+    for (int i = 0; i < n; i++) {
+        members[num_members++] = pids[i];
+        if (helpers[i] > 0) members[num_members++] = helpers[i];
+    }
+    return new_job(members, num_members, pids[n - 1]);
+}
+
+// Launch commands[0..n-1] and wait for them, or hand them to the job
+// scheduler when they run in the background. Returns the last stage's
+// exit status.
+static int launch(command_t* commands, int n, int background) {
+    char text[MAX_LEN];
+    
+    if (background) {
+        submit_job(commands, n, job_text(commands, n, text, sizeof(text)));
+        return 0;
+    }
+    
+    job_t* job = start_pipeline(commands, n);
+    if (job == NULL) return 1;
+    
+    long long wait_start = stats_clock();
+    int status = wait_for_job(job, 1, &launch_usage);
+    shell_stats.wait_ns += stats_clock() - wait_start;
+    shell_stats.waits++;
+    
+    // Ctrl-Z: the job stays in the table for fg/bg
+    if (job->state == JOB_STOPPED) {
+        int id = add_job(job, job_text(commands, n, text, sizeof(text)));
+        printf("\n[%d] Stopped %s\n", id, job->command);
+        return status;
+    }
+    free_job(job);
+    return status;
+}
+
+// Run a single external command
+int execute_single_command(command_t* cmd) {
+    if (cmd->args[0] == NULL) return -1;
+    return launch(cmd, 1, cmd->background);
+}
+
+// Run every stage of a pipeline
+int execute_pipeline(pipeline_t* pipeline) {
+    if (pipeline == NULL || pipeline->num_commands == 0) return -1;
+    return launch(pipeline->commands, pipeline->num_commands, pipeline->background);
+}
+
+// Point fd at target while a command runs in the shell, keeping a copy
+// of the original above the descriptors scripts use. Returns the copy,
+// or -1.
+static int save_and_redirect(int target, int fd) {
+    int saved = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+    if (saved >= 0) dup2(target, fd);
+    close(target);
+    return saved;
+}
+
+static void restore_fd(int saved, int fd) {
+    if (saved < 0) return;
+    dup2(saved, fd);
+    close(saved);
+}
+
+// Run a lone foreground builtin or compound command in the shell itself.
+// Its redirections are applied to the shell's own stdin/stdout and undone
+// afterwards, which costs a few dup2 calls instead of a fork, and lets
+// `while read line; do ...; done < file` set variables in the shell.
+// Several output targets need the tee helper, so those still go through
+// launch().
+static int run_in_shell(command_t* cmd) {
+    if (cmd->num_extra_outputs > 0) return launch(cmd, 1, 0);
+    
+    int in_fd, out_fd;
+    if (setup_redirection(cmd, &in_fd, &out_fd) < 0) return 1;
+    
+    // Output buffered so far belongs to the old stdout
+    int saved_in = -1, saved_out = -1;
+    if (out_fd >= 0) {
+        fflush(stdout);
+        saved_out = save_and_redirect(out_fd, STDOUT_FILENO);
+    }
+    if (in_fd >= 0) saved_in = save_and_redirect(in_fd, STDIN_FILENO);
+    
+    int status;
+    if (cmd->compound != NULL) {
+        status = execute_node(cmd->compound);
+    } else {
+        handle_builtin(cmd->args);
+        status = builtin_status;
+    }
+    
+    // Flush even without redirection, or output from the next external
+    // command could overtake it
+    fflush(stdout);
+    restore_fd(saved_out, STDOUT_FILENO);
+    restore_fd(saved_in, STDIN_FILENO);
+    return status;
+}
+
+// Expand and run one pipeline of a parsed line. A lone foreground command
+// may be a variable assignment, a builtin or a compound command, all of
+// which run in the shell itself.
+static int run_pipeline_untimed(pipeline_t* pipeline) {
+    if (shell_options.pipeopt && pipeline->num_commands > 1) {
+        optimize_pipeline(pipeline);
+    }
+    
+    command_t* first = &pipeline->commands[0];
+    int simple = pipeline->num_commands == 1 && first->input_file == NULL && first->here_text == NULL &&
+                 first->output_file == NULL && !pipeline->background;
+    
+    // Cached stat results stay valid only across consecutive tests. Anything
+    // else, assignments included, may change the filesystem; a test's own
+    // substitutions are covered by command_substitution().
+    char* name = first->args[0];
+    int test = pipeline->num_commands == 1 && first->compound == NULL && name != NULL &&
+               (first->conditional || strcmp(name, "test") == 0 || strcmp(name, "[") == 0);
+    if (!test) test_cache_clear();
+    
+    // $? is not touched until the command is done, so X=$? still sees it
+    substitution_status = 0;
+    if (simple && first->argc == 1 && is_variable_assignment(first->args[0])) {
+        return handle_variable_assignment(first->args[0]) == 0 ? substitution_status : 1;
+    }
+    
+    expansion_error = 0;
+    for (int i = 0; i < pipeline->num_commands; i++) {
+        command_t* cmd = &pipeline->commands[i];
+        
+        // Words can split into several fields or vanish altogether,
+        // except inside [[ ... ]]
+        if (cmd->conditional) expand_conditional(cmd->args);
+        else expand_variables(&cmd->args);
+        for (cmd->argc = 0; cmd->args[cmd->argc] != NULL; cmd->argc++);
+        if (cmd->input_file) cmd->input_file = expand_word(cmd->input_file);
+        if (cmd->output_file) cmd->output_file = expand_word(cmd->output_file);
+        if (cmd->here_kind == HERE_DOC) {
+            cmd->here_text = expand_here_document(cmd->here_text);
+        } else if (cmd->here_kind == HERE_STRING) {
+            // A here-string is the expanded word plus a newline
+            char* word = expand_word(cmd->here_text);
+            size_t length = strlen(word);
+            cmd->here_text = arena_alloc(&line_arena, length + 2);
+            memcpy(cmd->here_text, word, length);
+            strcpy(cmd->here_text + length, "\n");
+        }
+        cmd->here_kind = HERE_NONE;
+        
+        // The target array may belong to a syntax tree, so dequote a copy
+        if (cmd->num_extra_outputs > 0) {
+            output_target_t* targets = arena_alloc(&line_arena, cmd->num_extra_outputs * sizeof(output_target_t));
+            for (int j = 0; j < cmd->num_extra_outputs; j++) {
+                targets[j].file = expand_word(cmd->extra_outputs[j].file);
+                targets[j].append = cmd->extra_outputs[j].append;
+            }
+            cmd->extra_outputs = targets;
+        }
+    }
+    if (expansion_error) return 1;
+    if (simple && first->args[0] == NULL && first->compound == NULL) return substitution_status;
+    
+    name = first->args[0];
+    if (pipeline->num_commands == 1 && !pipeline->background && (first->compound != NULL || is_builtin(name))) {
+        return run_in_shell(first);
+    }
+    return execute_pipeline(pipeline);
+}
+
+// Run one pipeline, reporting wall/user/sys time and max RSS afterwards
+// when it was prefixed with the time keyword
+int run_pipeline(pipeline_t* pipeline) {
+    if (!pipeline->timed) return last_status = run_pipeline_untimed(pipeline);
+    
+    struct rusage self_before, self_after;
+    memset(&launch_usage, 0, sizeof(launch_usage));
+    getrusage(RUSAGE_SELF, &self_before);
+    long long start = stats_clock();
+    
+    int status = run_pipeline_untimed(pipeline);
+    
+    long long real_ns = stats_clock() - start;
+    getrusage(RUSAGE_SELF, &self_after);
+    
+    // Children reaped by launch() plus whatever ran inside the shell
+    struct rusage usage = launch_usage;
+    struct timeval delta;
+    timersub(&self_after.ru_utime, &self_before.ru_utime, &delta);
+    timeradd(&usage.ru_utime, &delta, &usage.ru_utime);
+    timersub(&self_after.ru_stime, &self_before.ru_stime, &delta);
+    timeradd(&usage.ru_stime, &delta, &usage.ru_stime);
+    
+    print_time_report(real_ns, &usage);
+    return last_status = status;
+}
+
+// Parse and run a full command line. The line is terminated in place
+// by the parser, and must not need more lines to be complete.
+int execute_command_chain(char* cmdline) {
+    int incomplete = 0;
+    arena_mark_t mark = arena_mark(&line_arena);
+    node_t* root = parse_program(&line_arena, cmdline, &incomplete);
+    if (root == NULL) {
+        if (incomplete) fprintf(stderr, "myshell: syntax error: unexpected end of line\n");
+        arena_release(&line_arena, mark);
+        return 2;
+    }
+    
+    int status = execute_node(root);
+    arena_release(&line_arena, mark);
+    return status;
+}
@@ -0,0 +1,534 @@
+#include "shell.h"
+#include <ctype.h>
+#include <fnmatch.h>
+
+// Word expansion.
+//
+// Each word is expanded in a single pass: quote removal, $NAME and ${...}
+// parameter expansion, $? $$ $! and $0, command substitution, field
+// splitting of unquoted results on IFS and, for arguments, pathname
+// expansion (glob.c). Fields are built in a scratch buffer reused from
+// word to word, each NUL-terminated after the one before; only the
+// finished fields are copied to line_arena. Arguments with no $, `,
+// quote, backslash or pattern character are used as they are.
+
+// Set when ${NAME?message} fails; the command is then not run
+int expansion_error = 0;
+
+#define DEFAULT_IFS " \t\n"
+
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} buffer_t;
+
+// One word being expanded
+typedef struct {
+    buffer_t* text;      // finished fields, then the current one
+    size_t field_start;  // offset of the current field in text
+    int in_field;        // the current field exists, even if empty ("")
+    int num_fields;
+    const char* ifs;     // split unquoted expansions on these, or NULL
+    int split_text;      // split unquoted text too (the word in ${X:-word})
+    int glob;            // fields are pathname patterns
+    int has_glob;        // the current field has an unquoted * ? or [
+    int escaped;         // backslashes were added to the current field
+} expansion_t;
+
+// Scratch buffers by nesting level: a builtin run for $(...) or the word
+// of ${NAME:-word} is expanded while the outer word is half built
+#define SCRATCH_LEVELS 8
+static buffer_t scratch[SCRATCH_LEVELS];
+static int depth = 0;
+
+static void buffer_append(buffer_t* buffer, const char* s, size_t n) {
+    if (buffer->length + n + 1 > buffer->capacity) {
+        buffer->capacity = (buffer->length + n + 1) * 2;
+        if (buffer->capacity < 256) buffer->capacity = 256;
+        buffer->data = realloc(buffer->data, buffer->capacity);
+    }
+    memcpy(buffer->data + buffer->length, s, n);
+    buffer->length += n;
+}
+
+// Add text to the current field. When the field is a pattern, quoted
+// pattern characters (and backslashes) get a backslash to keep them literal.
+static void put_text(expansion_t* ex, const char* s, size_t n, int quoted) {
+    size_t start = 0;
+    
+    for (size_t i = 0; ex->glob && i < n; i++) {
+        char c = s[i];
+        if (c != '*' && c != '?' && c != '[' && c != ']' && c != '\\') continue;
+        if (!quoted && c != '\\') {
+            if (c != ']') ex->has_glob = 1;
+            continue;
+        }
+        buffer_append(ex->text, s + start, i - start);
+        buffer_append(ex->text, "\\", 1);
+        ex->escaped = 1;
+        start = i;
+    }
+    buffer_append(ex->text, s + start, n - start);
+    ex->in_field = 1;
+}
+
+static void put(expansion_t* ex, const char* s, size_t n) {
+    put_text(ex, s, n, 0);
+}
+
+static void put_quoted(expansion_t* ex, const char* s, size_t n) {
+    put_text(ex, s, n, 1);
+}
+
+// Drop the backslashes put_text() added to the field at start
+static void unescape(buffer_t* text, size_t start) {
+    char* out = text->data + start;
+    for (char* p = out; p < text->data + text->length; p++) {
+        if (*p == '\\') p++;
+        *out++ = *p;
+    }
+    text->length = out - text->data;
+}
+
+static void end_field(expansion_t* ex) {
+    buffer_t* text = ex->text;
+    char** matches;
+    int count;
+    
+    buffer_append(text, "", 1);
+    arena_mark_t mark = arena_mark(&line_arena);
+    if (ex->has_glob && glob_is_pattern(text->data + ex->field_start) &&
+        (count = glob_pathnames(text->data + ex->field_start, &matches)) > 0) {
+        // The pattern is replaced by the paths it matched, which are only
+        // kept in line_arena until they are copied here
+        text->length = ex->field_start;
+        for (int i = 0; i < count; i++) {
+            buffer_append(text, matches[i], strlen(matches[i]) + 1);
+        }
+        arena_release(&line_arena, mark);
+        ex->num_fields += count;
+    } else {
+        // No match: the word stays as it was
+        if (ex->escaped) unescape(text, ex->field_start);
+        ex->num_fields++;
+    }
+    ex->field_start = text->length;
+    ex->in_field = 0;
+    ex->has_glob = 0;
+    ex->escaped = 0;
+}
+
+// Add the result of an expansion. Unquoted, it is split on IFS: runs of
+// IFS white space separate fields, any other IFS character ends one.
+static void put_value(expansion_t* ex, const char* value, size_t n, int quoted) {
+    if (quoted || ex->ifs == NULL) {
+        if (quoted || n > 0) put_text(ex, value, n, quoted);
+        return;
+    }
+    
+    while (n > 0) {
+        size_t span = 0;
+        while (span < n && strchr(ex->ifs, value[span]) == NULL) span++;
+        if (span > 0) put(ex, value, span);
+        if (span == n) break;
+        
+        char c = value[span];
+        if (c == ' ' || c == '\t' || c == '\n') {
+            if (ex->in_field) end_field(ex);
+        } else {
+            end_field(ex);
+        }
+        value += span + 1;
+        n -= span + 1;
+    }
+}
+
+static void expand_text(expansion_t* ex, const char* p, const char* end, char quote, int heredoc);
+
+// Start expanding a word on the next scratch level; finish() when its
+// fields have been copied out
+static void start(expansion_t* ex, buffer_t* local, const char* ifs) {
+    memset(ex, 0, sizeof(*ex));
+    ex->text = depth < SCRATCH_LEVELS ? &scratch[depth] : local;
+    ex->text->length = 0;
+    ex->ifs = ifs;
+    depth++;
+}
+
+static void finish(buffer_t* local) {
+    depth--;
+    free(local->data);
+}
+
+// Expand text[0..length) to a single string on the next scratch level. It
+// stays valid until the matching finish().
+static char* start_nested(const char* text, size_t length, buffer_t* local) {
+    expansion_t ex;
+    start(&ex, local, NULL);
+    expand_text(&ex, text, text + length, '\0', 0);
+    buffer_append(ex.text, "", 1);
+    return ex.text->data;
+}
+
+static void put_substitution(expansion_t* ex, const char* text, size_t length, int quoted) {
+    size_t output_length;
+    char* output = command_substitution(text, length, &output_length);
+    put_value(ex, output, output_length, quoted);
+    free(output);
+}
+
+// Run the command between the backquotes at open and close. Inside them
+// \` \\ and \$ stand for the character itself.
+static void put_backquoted(expansion_t* ex, const char* open, const char* close, int quoted) {
+    char* text = malloc(close - open);
+    size_t length = 0;
+    
+    for (const char* q = open + 1; q < close; q++) {
+        if (*q == '\\' && strchr("`\\$", q[1]) != NULL) q++;
+        text[length++] = *q;
+    }
+    put_substitution(ex, text, length, quoted);
+    free(text);
+}
+
+static int is_name_start(char c) {
+    return isalpha((unsigned char)c) || c == '_';
+}
+
+static int is_name_char(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+// Value of parameter name[0..length), or NULL if it is unset. Special
+// parameters are formatted into number.
+static const char* parameter(const char* name, size_t length, char* number) {
+    char key[256];
+    
+    if (length == 1 && !is_name_start(name[0])) {
+        switch (name[0]) {
+            case '?':
+                sprintf(number, "%d", last_status);
+                return number;
+            case '$':
+                sprintf(number, "%d", (int)shell_pid);
+                return number;
+            case '!':
+                if (last_background_pid <= 0) return NULL;
+                sprintf(number, "%d", (int)last_background_pid);
+                return number;
+            case '#':
+                return "0";
+            case '0':
+                return "myshell";
+        }
+        return NULL;
+    }
+    if (length >= sizeof(key)) return NULL;
+    memcpy(key, name, length);
+    key[length] = '\0';
+    return get_variable(key);
+}
+
+// Strip the shortest or longest prefix or suffix of value matching pattern
+static void remove_pattern(expansion_t* ex, const char* value, const char* pattern, int suffix, int longest,
+                           int quoted) {
+    size_t length = strlen(value);
+    char small[256];
+    char* copy = length < sizeof(small) ? small : malloc(length + 1);
+    memcpy(copy, value, length + 1);
+    
+    for (size_t i = 0; i <= length; i++) {
+        // Prefixes grow from the empty one, suffixes shrink from the whole
+        size_t cut = longest ? length - i : i;
+        int match;
+        if (suffix) {
+            match = fnmatch(pattern, copy + (length - cut), 0) == 0;
+        } else {
+            char saved = copy[cut];
+            copy[cut] = '\0';
+            match = fnmatch(pattern, copy, 0) == 0;
+            copy[cut] = saved;
+        }
+        if (match) {
+            if (suffix) put_value(ex, value, length - cut, quoted);
+            else put_value(ex, value + cut, length - cut, quoted);
+            if (copy != small) free(copy);
+            return;
+        }
+    }
+    put_value(ex, value, length, quoted);
+    if (copy != small) free(copy);
+}
+
+// ${...} at p, ending at close
+static void expand_braced(expansion_t* ex, const char* p, const char* close, int quoted) {
+    const char* name = p + 2;
+    char number[32];
+    
+    // ${#NAME}: length of the value
+    int length_of = name[0] == '#' && name + 1 < close;
+    if (length_of) name++;
+    
+    const char* op = name;
+    if (is_name_start(*op)) {
+        while (is_name_char(*op)) op++;
+    } else if (op < close && strchr("?$!#0", *op) != NULL) {
+        op++;
+    }
+    if (op == name || (length_of && op != close)) {
+        fprintf(stderr, "myshell: %.*s: bad substitution\n", (int)(close - p + 1), p);
+        expansion_error = 1;
+        return;
+    }
+    
+    const char* value = parameter(name, op - name, number);
+    if (op == close) {
+        if (length_of) {
+            sprintf(number, "%zu", value != NULL ? strlen(value) : 0);
+            value = number;
+        }
+        if (value != NULL) put_value(ex, value, strlen(value), quoted);
+        return;
+    }
+    
+    // Operator and its word: ${NAME:-word}, ${NAME#pattern}, ...
+    int colon = (*op == ':');
+    if (colon) op++;
+    char kind = *op;
+    int doubled = !colon && (kind == '#' || kind == '%') && op[1] == kind;
+    const char* word = op + 1 + doubled;
+    if (strchr("-=+?#%", kind) == NULL || (colon && (kind == '#' || kind == '%'))) {
+        fprintf(stderr, "myshell: %.*s: bad substitution\n", (int)(close - p + 1), p);
+        expansion_error = 1;
+        return;
+    }
+    
+    // With a colon an empty value counts as unset. The word is expanded
+    // in place, so its own quotes decide how it is split.
+    int set = value != NULL && (!colon || value[0] != '\0');
+    int name_length = op - colon - name;
+    buffer_t local = {NULL, 0, 0};
+    char* text;
+    if (set && (kind == '-' || kind == '=' || kind == '?')) {
+        put_value(ex, value, strlen(value), quoted);
+        return;
+    }
+    switch (kind) {
+        case '-':
+        case '+':
+            if (kind == '+' && !set) break;
+            ex->split_text++;
+            expand_text(ex, word, close, quoted ? '"' : '\0', 0);
+            ex->split_text--;
+            break;
+        case '=':
+            text = start_nested(word, close - word, &local);
+            if (is_name_start(name[0])) {
+                char key[256];
+                snprintf(key, sizeof(key), "%.*s", name_length, name);
+                set_variable(key, text);
+            }
+            put_value(ex, text, strlen(text), quoted);
+            finish(&local);
+            break;
+        case '?':
+            text = start_nested(word, close - word, &local);
+            fprintf(stderr, "myshell: %.*s: %s\n", name_length, name,
+                    text[0] != '\0' ? text : "parameter null or not set");
+            finish(&local);
+            expansion_error = 1;
+            // A script stops here; an interactive shell only skips the command
+            if (!input_is_interactive()) exit(1);
+            break;
+        default:
+            text = start_nested(word, close - word, &local);
+            remove_pattern(ex, value != NULL ? value : "", text, kind == '%', doubled, quoted);
+            finish(&local);
+            break;
+    }
+}
+
+// The $ expansion at p; returns its last character
+static const char* expand_dollar(expansion_t* ex, const char* p, int quoted) {
+    const char* close;
+    char number[32];
+    
+    if (p[1] == '(' && (close = skip_substitution((char*)p + 1)) != NULL) {
+        put_substitution(ex, p + 2, close - p - 2, quoted);
+        return close;
+    }
+    if (p[1] == '{' && (close = skip_substitution((char*)p + 1)) != NULL) {
+        expand_braced(ex, p, close, quoted);
+        return close;
+    }
+    if (is_name_start(p[1])) {
+        const char* end = p + 1;
+        while (is_name_char(*end)) end++;
+        const char* value = parameter(p + 1, end - p - 1, number);
+        if (value != NULL) put_value(ex, value, strlen(value), quoted);
+        return end - 1;
+    }
+    if (p[1] != '\0' && strchr("?$!#0", p[1]) != NULL) {
+        const char* value = parameter(p + 1, 1, number);
+        if (value != NULL) put_value(ex, value, strlen(value), quoted);
+        return p + 1;
+    }
+    put(ex, p, 1);
+    return p;
+}
+
+static int is_special(char c) {
+    return c == '$' || c == '`' || c == '\\' || c == '"' || c == '\'';
+}
+
+// Expand p[0..end), where quote is the quoting in effect at p. In a
+// here-document quotes are ordinary characters and a backslash only
+// escapes $ ` \ and newline.
+static void expand_text(expansion_t* ex, const char* p, const char* end, char quote, int heredoc) {
+    for (; p < end; p++) {
+        const char* close;
+        if (quote == '\'') {
+            close = memchr(p, '\'', end - p);
+            if (close == NULL) close = end;
+            put_quoted(ex, p, close - p);
+            p = close;
+            quote = '\0';
+        } else if (!heredoc && (*p == '"' || (*p == '\'' && quote == '\0'))) {
+            quote = (quote == *p) ? '\0' : *p;
+            ex->in_field = 1;
+        } else if (*p == '\\' && p + 1 < end) {
+            if (heredoc ? strchr("$`\\\n", p[1]) != NULL : (quote == '\0' || strchr("\"\\$`", p[1]) != NULL)) {
+                p++;
+                if (*p != '\n' || !heredoc) put_quoted(ex, p, 1);
+            } else {
+                put_quoted(ex, p, 1);
+            }
+        } else if (*p == '$') {
+            p = expand_dollar(ex, p, quote != '\0' || heredoc);
+        } else if (*p == '`' && (close = skip_backquote((char*)p)) != NULL) {
+            put_backquoted(ex, p, close, quote != '\0' || heredoc);
+            p = close;
+        } else {
+            // Plain text up to the next character that means something
+            const char* stop = p + 1;
+            while (stop < end && !is_special(*stop)) stop++;
+            if (quote != '\0') put_quoted(ex, p, stop - p);
+            else if (ex->split_text) put_value(ex, p, stop - p, 0);
+            else put(ex, p, stop - p);
+            p = stop - 1;
+        }
+    }
+}
+
+// Expand one word without field splitting (assignments, redirection
+// targets, here-strings). The result is in line_arena unless the word
+// needed no expansion.
+char* expand_word(char* word) {
+    if (strpbrk(word, "$`'\"\\") == NULL) return word;
+    
+    expansion_t ex;
+    buffer_t local = {NULL, 0, 0};
+    start(&ex, &local, NULL);
+    expand_text(&ex, word, word + strlen(word), '\0', 0);
+    char* result = arena_strndup(&line_arena, ex.text->data != NULL ? ex.text->data : "", ex.text->length);
+    finish(&local);
+    return result;
+}
+
+// Expand a word used as a pattern, without field splitting. Quoted
+// pattern characters get a backslash, so they only match themselves.
+char* expand_pattern(char* word) {
+    if (strpbrk(word, "$`'\"\\") == NULL) return word;
+    
+    expansion_t ex;
+    buffer_t local = {NULL, 0, 0};
+    start(&ex, &local, NULL);
+    ex.glob = 1;
+    expand_text(&ex, word, word + strlen(word), '\0', 0);
+    char* result = arena_strndup(&line_arena, ex.text->data != NULL ? ex.text->data : "", ex.text->length);
+    finish(&local);
+    return result;
+}
+
+// Expand the words of [[ ... ]] in place. Each stays one word, even when
+// empty or unquoted, and the right side of = == != is a pattern.
+void expand_conditional(char** args) {
+    // Operators are recognised as written, so a value of "==" is not one
+    char* previous = args[0];
+    for (int i = 1; args[i] != NULL; i++) {
+        int pattern = i >= 2 && (strcmp(previous, "=") == 0 || strcmp(previous, "==") == 0 ||
+                                 strcmp(previous, "!=") == 0);
+        previous = args[i];
+        args[i] = pattern ? expand_pattern(args[i]) : expand_word(args[i]);
+    }
+}
+
+// Expand the body of a here-document with an unquoted delimiter
+char* expand_here_document(char* body) {
+    if (strpbrk(body, "$`\\") == NULL) return body;
+    
+    expansion_t ex;
+    buffer_t local = {NULL, 0, 0};
+    start(&ex, &local, NULL);
+    expand_text(&ex, body, body + strlen(body), '\0', 1);
+    char* result = arena_strndup(&line_arena, ex.text->data != NULL ? ex.text->data : "", ex.text->length);
+    finish(&local);
+    return result;
+}
+
+// Room for needed more fields after out[0..count). capacity is 0 while the
+// words are still replaced in place in the argument array.
+static char** make_room(char** out, int count, int needed, int* capacity) {
+    if (count + needed + 1 <= *capacity) return out;
+    
+    *capacity = (count + needed + 1) * 2;
+    char** grown = arena_alloc(&line_arena, *capacity * sizeof(char*));
+    memcpy(grown, out, count * sizeof(char*));
+    return grown;
+}
+
+// Expand every argument into zero or more fields. Words that need no
+// expansion stay where they are; the argument array is only rebuilt (in
+// line_arena) once some word does not produce exactly one field.
+void expand_variables(char*** arglist_ptr) {
+    if (arglist_ptr == NULL || *arglist_ptr == NULL) return;
+    
+    long long start_time = stats_clock();
+    char** args = *arglist_ptr;
+    char** out = args;
+    int count = 0;
+    int capacity = 0;
+    const char* ifs = NULL;
+    
+    for (int i = 0; args[i] != NULL; i++) {
+        char* word = args[i];
+        if (strpbrk(word, "$`'\"\\*?[") == NULL) {
+            if (capacity > 0) out = make_room(out, count, 1, &capacity);
+            out[count++] = word;
+            continue;
+        }
+        
+        if (ifs == NULL && (ifs = get_variable("IFS")) == NULL) ifs = DEFAULT_IFS;
+        expansion_t ex;
+        buffer_t local = {NULL, 0, 0};
+        start(&ex, &local, ifs);
+        ex.glob = 1;
+        expand_text(&ex, word, word + strlen(word), '\0', 0);
+        if (ex.in_field) end_field(&ex);
+        
+        if (capacity > 0 || ex.num_fields != 1) out = make_room(out, count, ex.num_fields, &capacity);
+        char* field = ex.text->data;
+        for (int f = 0; f < ex.num_fields; f++) {
+            size_t length = strlen(field);
+            out[count++] = arena_strndup(&line_arena, field, length);
+            field += length + 1;
+        }
+        finish(&local);
+    }
+    out[count] = NULL;
+    *arglist_ptr = out;
+    
+    shell_stats.expand_ns += stats_clock() - start_time;
+    shell_stats.expand_calls++;
+}
@@ -0,0 +1,344 @@
+#include "shell.h"
+#include <dirent.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <sys/syscall.h>
+
+// Pathname expansion: * ? [...] and ** in arguments.
+//
+// Directories are read with getdents64 into a large buffer, and d_type
+// tells directories apart, so only symlinks (and filesystems that leave
+// d_type unset) need a stat. Listings are cached until glob_cache_clear(),
+// which the shell calls once per command line, so several globs on one
+// directory in a line cost one scan. A cached listing is reused only while
+// the directory's mtime is unchanged, which keeps `touch x; echo *` right,
+// and the listing was read in a later second than that mtime: timestamps
+// can be as coarse as the clock tick, so a file created in the same tick
+// as the listing may leave the mtime as it was. Components without
+// pattern characters are never listed at all. Matches
+// go to line_arena, where the caller releases them once it has copied them,
+// so a loop that globs on every pass does not grow the cache.
+
+#define GETDENTS_BUFFER (256 * 1024)
+
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// One directory as read by getdents64
+typedef struct {
+    char* path;
+    unsigned int hash;
+    struct timespec mtime;
+    time_t read_at;         // when the directory was read
+    char** names;
+    unsigned char* types;   // d_type of each name
+    int count;
+} listing_t;
+
+static arena_t glob_arena;       // listings and their names
+static listing_t** listings;     // open addressing on the path
+static int listings_size;        // power of two
+static int listings_used;
+static int listings_stale;       // some listing was replaced by a newer one
+static char* dents;              // getdents64 buffer
+
+static char** results;
+static int num_results;
+static int results_capacity;
+
+static unsigned int hash_path(const char* s) {
+    unsigned int h = 2166136261u; // FNV-1a
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static listing_t** listing_slot(const char* path, unsigned int hash) {
+    unsigned int mask = listings_size - 1;
+    unsigned int i = hash & mask;
+    
+    while (listings[i] != NULL) {
+        if (listings[i]->hash == hash && strcmp(listings[i]->path, path) == 0) break;
+        i = (i + 1) & mask;
+    }
+    return &listings[i];
+}
+
+static void listings_grow() {
+    listing_t** old = listings;
+    int old_size = listings_size;
+    
+    listings_size = listings_size ? listings_size * 2 : 64;
+    listings = calloc(listings_size, sizeof(listing_t*));
+    for (int i = 0; i < old_size; i++) {
+        if (old[i] != NULL) *listing_slot(old[i]->path, old[i]->hash) = old[i];
+    }
+    free(old);
+}
+
+// Forget every listing; called before each command line
+void glob_cache_clear() {
+    arena_reset(&glob_arena);
+    if (listings != NULL) memset(listings, 0, listings_size * sizeof(listing_t*));
+    listings_used = 0;
+    listings_stale = 0;
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(*(char**)a, *(char**)b);
+}
+
+// Read the directory at path, or reuse the listing cached for it. Names
+// are kept sorted, so matches mostly come out in order. A stale listing is
+// replaced, not freed, as a caller may still be walking it.
+static listing_t* read_listing(const char* path) {
+    struct stat st;
+    if (stat(path, &st) < 0 || !S_ISDIR(st.st_mode)) return NULL;
+    
+    if (listings_used * 2 >= listings_size) listings_grow();
+    unsigned int hash = hash_path(path);
+    listing_t** slot = listing_slot(path, hash);
+    if (*slot != NULL && (*slot)->mtime.tv_sec == st.st_mtim.tv_sec &&
+        (*slot)->mtime.tv_nsec == st.st_mtim.tv_nsec && (*slot)->read_at > st.st_mtim.tv_sec) {
+        return *slot;
+    }
+    
+    // Taken before reading, so a change made while we read looks recent
+    time_t read_at = time(NULL);
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    if (dents == NULL) dents = malloc(GETDENTS_BUFFER);
+    
+    // Collect into growing arrays, then move them to the arena
+    int count = 0, capacity = 256;
+    char** names = malloc(capacity * sizeof(char*));
+    unsigned char* types = malloc(capacity);
+    long n;
+    while ((n = syscall(SYS_getdents64, fd, dents, GETDENTS_BUFFER)) > 0) {
+        for (long offset = 0; offset < n;) {
+            struct linux_dirent64* d = (struct linux_dirent64*)(dents + offset);
+            offset += d->d_reclen;
+            if (d->d_name[0] == '.' && (d->d_name[1] == '\0' || (d->d_name[1] == '.' && d->d_name[2] == '\0'))) {
+                continue;
+            }
+            if (count == capacity) {
+                capacity *= 2;
+                names = realloc(names, capacity * sizeof(char*));
+                types = realloc(types, capacity);
+            }
+            // The type rides in front of the name until the sort is done
+            size_t length = strlen(d->d_name);
+            char* entry = arena_alloc(&glob_arena, length + 2);
+            entry[0] = d->d_type;
+            memcpy(entry + 1, d->d_name, length + 1);
+            names[count++] = entry + 1;
+        }
+    }
+    close(fd);
+    qsort(names, count, sizeof(char*), compare_names);
+    for (int i = 0; i < count; i++) {
+        types[i] = names[i][-1];
+    }
+    
+    listing_t* listing = arena_alloc(&glob_arena, sizeof(listing_t));
+    listing->path = arena_strdup(&glob_arena, path);
+    listing->hash = hash;
+    listing->mtime = st.st_mtim;
+    listing->read_at = read_at;
+    listing->count = count;
+    listing->names = arena_alloc(&glob_arena, (count + 1) * sizeof(char*));
+    listing->types = arena_alloc(&glob_arena, count + 1);
+    memcpy(listing->names, names, count * sizeof(char*));
+    memcpy(listing->types, types, count);
+    free(names);
+    free(types);
+    
+    if (*slot == NULL) listings_used++;
+    else listings_stale = 1;
+    *slot = listing;
+    return listing;
+}
+
+// Whether s[0..n) has an unescaped * or ?, or a [ closed by a ]
+static int has_pattern(const char* s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == '\\') {
+            i++;
+        } else if (s[i] == '*' || s[i] == '?') {
+            return 1;
+        } else if (s[i] == '[' && memchr(s + i + 1, ']', n - i - 1) != NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int glob_is_pattern(const char* word) {
+    return has_pattern(word, strlen(word));
+}
+
+// Match name against a pattern of literal characters, * and ?, which is
+// what most globs are; fnmatch() handles the rest
+static int match_simple(const char* pattern, const char* name) {
+    const char* star = NULL;
+    const char* resume = NULL;
+    
+    while (*name != '\0') {
+        if (*pattern == '*') {
+            star = pattern++;
+            resume = name;
+        } else if (*pattern == '?' || *pattern == *name) {
+            pattern++;
+            name++;
+        } else if (star != NULL) {
+            // Let the last * swallow one more character and retry
+            pattern = star + 1;
+            name = ++resume;
+        } else {
+            return 0;
+        }
+    }
+    while (*pattern == '*') pattern++;
+    return *pattern == '\0';
+}
+
+static void add_result(const char* path, size_t length) {
+    if (num_results == results_capacity) {
+        results_capacity = results_capacity ? results_capacity * 2 : 256;
+        results = realloc(results, results_capacity * sizeof(char*));
+    }
+    results[num_results++] = arena_strndup(&line_arena, path, length);
+}
+
+// Entry i of a listing, whose full path is path, names a directory
+static int is_directory(listing_t* dir, int i, const char* path, int follow) {
+    struct stat st;
+    
+    if (dir->types[i] == DT_DIR) return 1;
+    if (dir->types[i] != DT_UNKNOWN && (dir->types[i] != DT_LNK || !follow)) return 0;
+    if ((follow ? stat(path, &st) : lstat(path, &st)) < 0) return 0;
+    return S_ISDIR(st.st_mode);
+}
+
+static void match_from(char* path, size_t length, const char* p);
+
+// ** stands for any number of directories. Symlinked directories are not
+// followed, so a loop cannot make it run forever.
+static void match_globstar(char* path, size_t length, const char* rest) {
+    // No directories at all
+    if (*rest != '\0') match_from(path, length, rest);
+    
+    path[length] = '\0';
+    listing_t* dir = read_listing(length > 0 ? path : ".");
+    if (dir == NULL) return;
+    
+    for (int i = 0; i < dir->count; i++) {
+        char* name = dir->names[i];
+        size_t name_length = strlen(name);
+        if (name[0] == '.' || length + name_length + 2 >= PATH_MAX) continue;
+        
+        memcpy(path + length, name, name_length + 1);
+        // A trailing ** matches everything below, files included
+        if (*rest == '\0') add_result(path, length + name_length);
+        if (is_directory(dir, i, path, 0)) {
+            path[length + name_length] = '/';
+            match_globstar(path, length + name_length + 1, rest);
+        }
+    }
+}
+
+// Add the paths matching the components at p below path[0..length), which
+// is empty or ends in a slash
+static void match_from(char* path, size_t length, const char* p) {
+    // Literal components are appended without listing their directory
+    const char* end;
+    while (1) {
+        end = strchrnul(p, '/');
+        if (has_pattern(p, end - p)) break;
+        
+        for (const char* q = p; q < end && length + 2 < PATH_MAX; q++) {
+            if (*q == '\\' && q + 1 < end) q++;
+            path[length++] = *q;
+        }
+        if (*end == '\0') {
+            // The whole path is fixed; it matches if it exists
+            struct stat st;
+            path[length] = '\0';
+            if (lstat(path, &st) == 0) add_result(path, length);
+            return;
+        }
+        path[length++] = '/';
+        p = end + 1;
+    }
+    
+    char component[NAME_MAX * 2 + 1];
+    if ((size_t)(end - p) >= sizeof(component)) return;
+    memcpy(component, p, end - p);
+    component[end - p] = '\0';
+    const char* rest = (*end == '\0') ? end : end + 1;
+    int simple = strpbrk(component, "[\\") == NULL;
+    
+    if (strcmp(component, "**") == 0) {
+        match_globstar(path, length, rest);
+        return;
+    }
+    
+    path[length] = '\0';
+    listing_t* dir = read_listing(length > 0 ? path : ".");
+    if (dir == NULL) return;
+    
+    for (int i = 0; i < dir->count; i++) {
+        char* name = dir->names[i];
+        
+        // Leading dots must be matched explicitly
+        if (name[0] == '.' && component[0] != '.') continue;
+        if (simple ? !match_simple(component, name) : fnmatch(component, name, 0) != 0) continue;
+        
+        size_t name_length = strlen(name);
+        if (length + name_length + 2 >= PATH_MAX) continue;
+        memcpy(path + length, name, name_length + 1);
+        if (*end == '\0') {
+            add_result(path, length + name_length);
+        } else if (is_directory(dir, i, path, 1)) {
+            path[length + name_length] = '/';
+            match_from(path, length + name_length + 1, rest);
+        }
+    }
+}
+
+// Expand pattern to the sorted paths matching it. Returns how many there
+// are; *matches is valid until the next call, and the strings are in
+// line_arena. A backslash makes the next character literal.
+int glob_pathnames(const char* pattern, char*** matches) {
+    char path[PATH_MAX];
+    size_t length = 0;
+    
+    // Replaced listings stay in the arena until it is reset. Nothing walks
+    // them between calls, so drop them all rather than let a loop pile
+    // them up.
+    if (listings_stale) glob_cache_clear();
+    
+    num_results = 0;
+    if (pattern[0] == '/') {
+        path[length++] = '/';
+        while (*pattern == '/') pattern++;
+    }
+    match_from(path, length, pattern);
+    
+    // Matches from one directory are already in order
+    for (int i = 1; i < num_results; i++) {
+        if (strcmp(results[i - 1], results[i]) > 0) {
+            qsort(results, num_results, sizeof(char*), compare_names);
+            break;
+        }
+    }
+    *matches = results;
+    return num_results;
+}
@@ -0,0 +1,655 @@
+#include "shell.h"
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+// Persistent history.
+//
+// Interactive lines are appended to $HISTFILE (default ~/.myshell_history),
+// one per line, and never rewritten. Next to it, HISTFILE.idx holds the
+// 64-bit file offset of every entry, so entry n is one array lookup. Both
+// files are mapped, not read, at startup: the cost does not grow with the
+// file. Shells sharing the files take flock() on the history file around
+// each append, which writes the line first and its offset second; a shell
+// that died in between leaves a short index whose tail is indexed again on
+// the next start.
+//
+// Ctrl-R searches a trigram index of the entries. HISTFILE.tri holds a
+// saved copy of it: a sorted key table and the posting lists, mapped like
+// the other two files and binary-searched in place, so a new shell's first
+// search costs no more than later ones. Entries newer than the saved copy
+// are indexed in memory as searches need them, and the file is rewritten
+// (to a temporary name, then renamed) once they amount to an eighth of it.
+// Only a history with no saved index at all pays for indexing every entry,
+// on its first search.
+
+// How many of the newest entries Up/Down can browse
+#define RECALL_SIZE 1000
+
+static int history_fd = -1;
+static int index_fd = -1;
+static char* history_map;
+static size_t history_mapped;
+static uint64_t* index_map;
+static size_t index_mapped;
+static int num_entries;
+
+// Trigram -> ascending list of the entries containing it
+typedef struct {
+    uint32_t key;    // trigram | TRIGRAM_USED, 0 for an empty slot
+    int count;
+    int capacity;
+    uint32_t* entries;
+} posting_t;
+
+#define TRIGRAM_USED 0x1000000
+
+// HISTFILE.tri: this header, num_keys saved_key_t sorted by key, then
+// num_postings entry numbers, each key's run ascending
+typedef struct {
+    uint32_t magic;
+    uint32_t covered;       // entries 1..covered are in the file
+    uint32_t num_keys;
+    uint32_t num_postings;
+    uint64_t last_offset;   // offset of entry `covered`, to spot a new history
+} saved_header_t;
+
+typedef struct {
+    uint32_t key;
+    uint32_t count;
+    uint32_t start;         // first of its entries in the postings
+} saved_key_t;
+
+#define TRIGRAM_MAGIC 0x49525431    // "1TRI"
+#define TRIGRAM_SAVE_MIN 1000       // fewer new entries are never worth a rewrite
+
+static char trigram_path[PATH_MAX];
+static saved_header_t* saved;       // mapped HISTFILE.tri, or NULL
+static size_t saved_mapped;
+
+static posting_t* trigrams;         // entries after saved->covered
+static size_t trigram_slots;
+static size_t trigram_used;
+static int trigram_indexed;  // entries 1..trigram_indexed are in the index
+
+static int reverse_search(int count, int key);
+static void load_trigrams();
+
+// Map the first size bytes of fd, replacing an older mapping
+static void *remap(int fd, void* map, size_t old_size, size_t size) {
+    if (map != NULL) munmap(map, old_size);
+    if (size == 0) return NULL;
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    return map == MAP_FAILED ? NULL : map;
+}
+
+// Pick up entries appended by this or any other shell
+static void sync_history() {
+    struct stat index_st, history_st;
+    
+    // The index first: any offset in it points at text already written
+    if (fstat(index_fd, &index_st) < 0 || fstat(history_fd, &history_st) < 0) return;
+    size_t index_size = index_st.st_size & ~(sizeof(uint64_t) - 1);
+    if (index_size != index_mapped) {
+        index_map = remap(index_fd, index_map, index_mapped, index_size);
+        index_mapped = index_map != NULL ? index_size : 0;
+    }
+    if ((size_t)history_st.st_size != history_mapped) {
+        history_map = remap(history_fd, history_map, history_mapped, history_st.st_size);
+        history_mapped = history_map != NULL ? history_st.st_size : 0;
+    }
+    num_entries = index_mapped / sizeof(uint64_t);
+}
+
+// Text of entry n (1-based), not NUL-terminated
+static char* entry(int n, size_t* length) {
+    uint64_t offset = index_map[n - 1];
+    if (offset >= history_mapped) {
+        *length = 0;
+        return "";
+    }
+    char* text = history_map + offset;
+    char* end = memchr(text, '\n', history_mapped - offset);
+    *length = end != NULL ? (size_t)(end - text) : history_mapped - offset;
+    return text;
+}
+
+// Index lines the index does not cover yet; called with the lock held
+static void index_tail() {
+    sync_history();
+    
+    size_t start = 0;
+    if (num_entries > 0) {
+        size_t length;
+        uint64_t last = index_map[num_entries - 1];
+        if (last >= history_mapped) {
+            // The history file was truncated or replaced: start over
+            if (ftruncate(index_fd, 0) < 0) return;
+            sync_history();
+        } else {
+            entry(num_entries, &length);
+            start = last + length + 1;
+        }
+    }
+    if (start >= history_mapped) return;
+    
+    size_t capacity = 1024, count = 0;
+    uint64_t* offsets = malloc(capacity * sizeof(uint64_t));
+    for (size_t pos = start; pos < history_mapped; ) {
+        char* end = memchr(history_map + pos, '\n', history_mapped - pos);
+        if (end == NULL) break;  // a line still being written
+        if (count == capacity) {
+            capacity *= 2;
+            offsets = realloc(offsets, capacity * sizeof(uint64_t));
+        }
+        offsets[count++] = pos;
+        pos = end - history_map + 1;
+    }
+    if (count > 0 && write(index_fd, offsets, count * sizeof(uint64_t)) < 0) {
+        perror("history index");
+    }
+    free(offsets);
+    sync_history();
+}
+
+// Open (creating) the history files and load the newest entries for Up/Down
+void init_history() {
+    char path[PATH_MAX];
+    char* file = get_variable("HISTFILE");
+    
+    if (file != NULL && file[0] != '\0') {
+        snprintf(path, sizeof(path), "%s", file);
+    } else if (getenv("HOME") != NULL) {
+        snprintf(path, sizeof(path), "%s/.myshell_history", getenv("HOME"));
+    } else {
+        return;
+    }
+    
+    history_fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    strncat(path, ".idx", sizeof(path) - strlen(path) - 1);
+    index_fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (history_fd < 0 || index_fd < 0) {
+        perror("myshell: history");
+        if (history_fd >= 0) close(history_fd);
+        if (index_fd >= 0) close(index_fd);
+        history_fd = index_fd = -1;
+        return;
+    }
+    
+    flock(history_fd, LOCK_EX);
+    index_tail();
+    flock(history_fd, LOCK_UN);
+    
+    snprintf(trigram_path, sizeof(trigram_path), "%.*s.tri", (int)(strlen(path) - 4), path);
+    load_trigrams();
+    
+    rl_bind_keyseq("\\C-r", reverse_search);
+    stifle_history(RECALL_SIZE);
+    for (int n = num_entries > RECALL_SIZE ? num_entries - RECALL_SIZE + 1 : 1; n <= num_entries; n++) {
+        size_t length;
+        char* text = entry(n, &length);
+        char* line = strndup(text, length);
+        add_history(line);
+        free(line);
+    }
+}
+
+int history_entries() {
+    if (history_fd >= 0) sync_history();
+    return num_entries;
+}
+
+// Record a command, skipping a repeat of the newest entry
+void add_to_history(const char* command) {
+    HIST_ENTRY* last = history_get(history_base + history_length - 1);
+    if (last == NULL || strcmp(last->line, command) != 0) {
+        add_history(command);
+    }
+    if (history_fd < 0 || strchr(command, '\n') != NULL) return;
+    
+    size_t length = strlen(command);
+    flock(history_fd, LOCK_EX);
+    index_tail();
+    
+    size_t last_length;
+    char* newest = num_entries > 0 ? entry(num_entries, &last_length) : NULL;
+    if (newest == NULL || last_length != length || memcmp(newest, command, length) != 0) {
+        uint64_t offset = history_mapped;
+        struct iovec line[2] = {{(char*)command, length}, {"\n", 1}};
+        if (writev(history_fd, line, 2) < 0 ||
+            write(index_fd, &offset, sizeof(offset)) < 0) {
+            perror("history");
+        }
+    }
+    flock(history_fd, LOCK_UN);
+}
+
+// Malloc'd copy of entry n (1-based), or NULL if there is none
+char* get_history_command(int n) {
+    if (history_fd >= 0) {
+        sync_history();
+        if (n < 1 || n > num_entries) return NULL;
+        size_t length;
+        char* text = entry(n, &length);
+        return strndup(text, length);
+    }
+    
+    // Without a history file only this session's lines are known
+    HIST_ENTRY* item = history_get(history_base + n - 1);
+    return item != NULL ? strdup(item->line) : NULL;
+}
+
+void print_history(int count) {
+    if (history_fd < 0) {
+        for (int i = count < history_length ? history_length - count : 0; i < history_length; i++) {
+            HIST_ENTRY* item = history_get(history_base + i);
+            if (item != NULL) printf("%5d  %s\n", i + 1, item->line);
+        }
+        return;
+    }
+    
+    sync_history();
+    for (int n = count < num_entries ? num_entries - count + 1 : 1; n <= num_entries; n++) {
+        size_t length;
+        char* text = entry(n, &length);
+        printf("%5d  %.*s\n", n, (int)length, text);
+    }
+}
+
+// history [n] - show the last n entries (default HISTORY_SIZE)
+void execute_history(char** args) {
+    int count = HISTORY_SIZE;
+    if (args[1] != NULL) {
+        count = atoi(args[1]);
+        if (count <= 0) {
+            fprintf(stderr, "history: %s: needs a positive number\n", args[1]);
+            builtin_status = 1;
+            return;
+        }
+    }
+    print_history(count);
+    builtin_status = 0;
+}
+
+// Expand !!, !n, !-n or !prefix at the start of the line. The result is
+// echoed and recorded in place of the ! line; NULL if there is no match.
+void handle_history_execution(char** cmdline) {
+    char* line = *cmdline;
+    char* rest;
+    char* command = NULL;
+    int total = history_entries();
+    
+    if (line[1] == '!') {
+        command = get_history_command(history_fd >= 0 ? total : history_length);
+        rest = line + 2;
+    } else if (isdigit((unsigned char)line[1]) || (line[1] == '-' && isdigit((unsigned char)line[2]))) {
+        long n = strtol(line + 1, &rest, 10);
+        if (n < 0) n += (history_fd >= 0 ? total : history_length) + 1;
+        command = get_history_command(n);
+    } else {
+        size_t length = strcspn(line + 1, " \t");
+        rest = line + 1 + length;
+        int newest = history_fd >= 0 ? total : history_length;
+        for (int n = newest; n >= 1 && length > 0 && command == NULL; n--) {
+            char* candidate = get_history_command(n);
+            if (candidate != NULL && strncmp(candidate, line + 1, length) == 0) {
+                command = candidate;
+            } else {
+                free(candidate);
+            }
+        }
+    }
+    
+    if (command == NULL) {
+        fprintf(stderr, "myshell: %.*s: event not found\n", (int)strcspn(line, " \t"), line);
+        free(line);
+        *cmdline = NULL;
+        return;
+    }
+    
+    char* expanded = malloc(strlen(command) + strlen(rest) + 1);
+    strcpy(expanded, command);
+    strcat(expanded, rest);
+    free(command);
+    free(line);
+    
+    printf("%s\n", expanded);
+    add_to_history(expanded);
+    *cmdline = expanded;
+}
+
+// Slot of key in the trigram table, or of the empty slot where it goes
+static posting_t* trigram_slot(uint32_t key) {
+    size_t i = (key * 2654435761u) & (trigram_slots - 1);
+    while (trigrams[i].key != 0 && trigrams[i].key != key) {
+        i = (i + 1) & (trigram_slots - 1);
+    }
+    return &trigrams[i];
+}
+
+static void grow_trigrams() {
+    posting_t* old = trigrams;
+    size_t old_slots = trigram_slots;
+    
+    trigram_slots = old_slots ? old_slots * 2 : 4096;
+    trigrams = calloc(trigram_slots, sizeof(posting_t));
+    for (size_t i = 0; i < old_slots; i++) {
+        if (old[i].key != 0) *trigram_slot(old[i].key) = old[i];
+    }
+    free(old);
+}
+
+// Empty the in-memory part of the index
+static void clear_trigrams() {
+    for (size_t i = 0; i < trigram_slots; i++) {
+        free(trigrams[i].entries);
+    }
+    free(trigrams);
+    trigrams = NULL;
+    trigram_slots = 0;
+    trigram_used = 0;
+}
+
+static uint32_t trigram_key(const char* text) {
+    return TRIGRAM_USED | (unsigned char)text[0] << 16 | (unsigned char)text[1] << 8 | (unsigned char)text[2];
+}
+
+static int saved_covered() {
+    return saved != NULL ? (int)saved->covered : 0;
+}
+
+static saved_key_t* saved_keys() {
+    return (saved_key_t*)(saved + 1);
+}
+
+static uint32_t* saved_postings() {
+    return (uint32_t*)(saved_keys() + saved->num_keys);
+}
+
+// The saved index is usable while the history still has its entries
+static int saved_matches_history() {
+    int covered = saved_covered();
+    return covered <= num_entries && (covered == 0 || index_map[covered - 1] == saved->last_offset);
+}
+
+static void unmap_saved() {
+    if (saved != NULL) munmap(saved, saved_mapped);
+    saved = NULL;
+    saved_mapped = 0;
+}
+
+// Map HISTFILE.tri if it is whole and belongs to this history; the
+// in-memory index then starts after the entries it covers
+static void load_trigrams() {
+    unmap_saved();
+    clear_trigrams();
+    
+    int fd = open(trigram_path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(saved_header_t)) {
+        saved = remap(fd, NULL, 0, st.st_size);
+        saved_mapped = saved != NULL ? st.st_size : 0;
+    }
+    if (fd >= 0) close(fd);
+    
+    // Page the lists in behind the first search rather than one by one
+    if (saved != NULL) madvise(saved, saved_mapped, MADV_WILLNEED);
+    if (saved != NULL && (saved->magic != TRIGRAM_MAGIC ||
+                          saved_mapped < sizeof(saved_header_t) + (uint64_t)saved->num_keys * sizeof(saved_key_t) +
+                                             (uint64_t)saved->num_postings * sizeof(uint32_t) ||
+                          !saved_matches_history())) {
+        unmap_saved();
+    }
+    trigram_indexed = saved_covered();
+}
+
+// Posting list of key in the saved index
+static uint32_t* saved_find(uint32_t key, int* count) {
+    *count = 0;
+    if (saved == NULL) return NULL;
+    
+    saved_key_t* keys = saved_keys();
+    uint32_t low = 0, high = saved->num_keys;
+    while (low < high) {
+        uint32_t mid = (low + high) / 2;
+        if (keys[mid].key < key) low = mid + 1;
+        else high = mid;
+    }
+    if (low == saved->num_keys || keys[low].key != key) return NULL;
+    *count = keys[low].count;
+    return saved_postings() + keys[low].start;
+}
+
+static int compare_keys(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Write the whole index, saved and in-memory parts merged, as the new
+// HISTFILE.tri and map it in place of both
+static void save_trigrams() {
+    int saved_keys_count = saved != NULL ? saved->num_keys : 0;
+    uint32_t* keys = malloc((saved_keys_count + trigram_used + 1) * sizeof(uint32_t));
+    size_t num_keys = 0;
+    for (int i = 0; i < saved_keys_count; i++) {
+        keys[num_keys++] = saved_keys()[i].key;
+    }
+    for (size_t i = 0; i < trigram_slots; i++) {
+        if (trigrams[i].key != 0) keys[num_keys++] = trigrams[i].key;
+    }
+    qsort(keys, num_keys, sizeof(uint32_t), compare_keys);
+    size_t unique = 0;
+    for (size_t i = 0; i < num_keys; i++) {
+        if (unique == 0 || keys[unique - 1] != keys[i]) keys[unique++] = keys[i];
+    }
+    num_keys = unique;
+    
+    // Saved entries come first: they are all older than the in-memory ones
+    saved_key_t* table = malloc((num_keys + 1) * sizeof(saved_key_t));
+    uint32_t total = 0;
+    for (size_t i = 0; i < num_keys; i++) {
+        int old_count;
+        saved_find(keys[i], &old_count);
+        posting_t* posting = trigrams != NULL ? trigram_slot(keys[i]) : NULL;
+        table[i].key = keys[i];
+        table[i].count = old_count + (posting != NULL && posting->key != 0 ? posting->count : 0);
+        table[i].start = total;
+        total += table[i].count;
+    }
+    
+    saved_header_t header = {TRIGRAM_MAGIC, trigram_indexed, num_keys, total,
+                             trigram_indexed > 0 ? index_map[trigram_indexed - 1] : 0};
+    char temporary[PATH_MAX + 16];
+    snprintf(temporary, sizeof(temporary), "%s.%d", trigram_path, (int)getpid());
+    // As private as the history itself
+    int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    FILE* file = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (file == NULL && fd >= 0) close(fd);
+    if (file != NULL) {
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(table, sizeof(saved_key_t), num_keys, file);
+        for (size_t i = 0; i < num_keys; i++) {
+            int old_count;
+            uint32_t* old = saved_find(keys[i], &old_count);
+            fwrite(old, sizeof(uint32_t), old_count, file);
+            posting_t* posting = trigrams != NULL ? trigram_slot(keys[i]) : NULL;
+            if (posting != NULL && posting->key != 0) fwrite(posting->entries, sizeof(uint32_t), posting->count, file);
+        }
+        // Another shell may have saved meanwhile; the last rename wins
+        if (fclose(file) != 0 || rename(temporary, trigram_path) != 0) unlink(temporary);
+    }
+    free(keys);
+    free(table);
+    load_trigrams();
+}
+
+// Add the entries since the last search to the in-memory index, and save
+// the index once enough have piled up
+static void index_trigrams() {
+    sync_history();
+    if (!saved_matches_history() || trigram_indexed > num_entries) {
+        // The history file was replaced: start over
+        unmap_saved();
+        clear_trigrams();
+        trigram_indexed = 0;
+    }
+    
+    for (int n = trigram_indexed + 1; n <= num_entries; n++) {
+        size_t length;
+        char* text = entry(n, &length);
+        for (size_t i = 0; i + 3 <= length; i++) {
+            if ((trigram_used + 1) * 2 > trigram_slots) grow_trigrams();
+            uint32_t key = trigram_key(text + i);
+            posting_t* posting = trigram_slot(key);
+            if (posting->key == 0) {
+                posting->key = key;
+                trigram_used++;
+            }
+            if (posting->count > 0 && posting->entries[posting->count - 1] == (uint32_t)n) continue;
+            if (posting->count == posting->capacity) {
+                posting->capacity = posting->capacity ? posting->capacity * 2 : 4;
+                posting->entries = realloc(posting->entries, posting->capacity * sizeof(uint32_t));
+            }
+            posting->entries[posting->count++] = n;
+        }
+    }
+    trigram_indexed = num_entries;
+    
+    int fresh = trigram_indexed - saved_covered();
+    if (fresh >= TRIGRAM_SAVE_MIN && fresh * 8 >= saved_covered()) save_trigrams();
+}
+
+static int entry_contains(int n, const char* query, size_t query_length) {
+    size_t length;
+    char* text = entry(n, &length);
+    return memmem(text, length, query, query_length) != NULL;
+}
+
+// Newest of the ascending entries[0..count) before `before` that contains
+// query, or 0
+static int newest_match(uint32_t* entries, int count, int before, const char* query, size_t query_length) {
+    int low = 0, high = count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (entries[mid] < (uint32_t)before) low = mid + 1;
+        else high = mid;
+    }
+    for (int i = low - 1; i >= 0; i--) {
+        if (entry_contains(entries[i], query, query_length)) return entries[i];
+    }
+    return 0;
+}
+
+// Newest entry before entry `before` that contains query, or 0
+int history_search(const char* query, int before) {
+    size_t query_length = strlen(query);
+    if (history_fd < 0 || query_length == 0) return 0;
+    index_trigrams();
+    if (before > num_entries + 1) before = num_entries + 1;
+    
+    // Too short for a trigram: check every entry
+    if (query_length < 3) {
+        for (int n = before - 1; n >= 1; n--) {
+            if (entry_contains(n, query, query_length)) return n;
+        }
+        return 0;
+    }
+    
+    // Only entries on the shortest posting list of the query's trigrams
+    // can match. Each list is the saved part followed by the newer
+    // in-memory part; walk them newest first and confirm each candidate.
+    uint32_t* shortest_saved = NULL;
+    posting_t* shortest = NULL;
+    int shortest_saved_count = 0;
+    int shortest_total = -1;
+    for (size_t i = 0; i + 3 <= query_length; i++) {
+        uint32_t key = trigram_key(query + i);
+        int saved_count;
+        uint32_t* saved_entries = saved_find(key, &saved_count);
+        posting_t* posting = trigrams != NULL ? trigram_slot(key) : NULL;
+        if (posting != NULL && posting->key == 0) posting = NULL;
+        
+        int total = saved_count + (posting != NULL ? posting->count : 0);
+        if (total == 0) return 0;
+        if (shortest_total < 0 || total < shortest_total) {
+            shortest_total = total;
+            shortest_saved = saved_entries;
+            shortest_saved_count = saved_count;
+            shortest = posting;
+        }
+    }
+    
+    int found = 0;
+    if (shortest != NULL) found = newest_match(shortest->entries, shortest->count, before, query, query_length);
+    if (found == 0) found = newest_match(shortest_saved, shortest_saved_count, before, query, query_length);
+    return found;
+}
+
+// Show the search prompt with entry n (or the original line) under it
+static void show_search(const char* query, int n, int failed, char* original) {
+    size_t length = 0;
+    char* text = n > 0 ? entry(n, &length) : NULL;
+    char* line = text != NULL ? strndup(text, length) : strdup(original);
+    
+    rl_message("(%sreverse-i-search)`%s': ", failed ? "failed " : "", query);
+    rl_replace_line(line, 0);
+    char* found = n > 0 && query[0] != '\0' ? strstr(line, query) : NULL;
+    rl_point = found != NULL ? found - line : 0;
+    rl_redisplay();
+    free(line);
+}
+
+// Ctrl-R: incremental search backwards through the whole history file.
+// Ctrl-R again moves to an older match, Ctrl-G cancels, any other key
+// keeps the match on the line and is handled as usual.
+static int reverse_search(int count, int key) {
+    char query[256] = "";
+    size_t query_length = 0;
+    int match = 0;
+    int failed = 0;
+    char* original = strdup(rl_line_buffer);
+    int original_point = rl_point;
+    
+    rl_save_prompt();
+    while (1) {
+        show_search(query, match, failed, original);
+        int c = rl_read_key();
+        
+        if (c == CTRL('R')) {
+            int older = history_search(query, match > 0 ? match : history_entries() + 1);
+            if (older > 0) match = older;
+            else rl_ding();
+        } else if (c == CTRL('G')) {
+            rl_restore_prompt();
+            rl_clear_message();
+            rl_replace_line(original, 0);
+            rl_point = original_point;
+            break;
+        } else if (c == RUBOUT || c == CTRL('H')) {
+            if (query_length > 0) query[--query_length] = '\0';
+            match = history_search(query, history_entries() + 1);
+            failed = query_length > 0 && match == 0;
+        } else if (isprint(c) && query_length < sizeof(query) - 1) {
+            query[query_length++] = c;
+            query[query_length] = '\0';
+            // Keep the current match while it still contains the query
+            int found = history_search(query, match > 0 ? match + 1 : history_entries() + 1);
+            failed = found == 0;
+            if (found > 0) match = found;
+            else rl_ding();
+        } else {
+            rl_restore_prompt();
+            rl_clear_message();
+            if (c == '\n' || c == '\r') rl_done = 1;
+            else rl_execute_next(c);
+            break;
+        }
+    }
+    free(original);
+    return 0;
+}
@@ -0,0 +1,210 @@
+#include "shell.h"
+#include <errno.h>
+#include <sys/mman.h>
+
+// Where command lines come from.
+//
+// Interactive shells read through readline. Scripts are mmap'd whole,
+// -c strings are read in place, and other input is read in chunks, so
+// batch input never touches readline, history or completion. Commands
+// share the shell's stdin, so a line read from it never takes bytes past
+// its newline away from them.
+
+#define INPUT_CHUNK 65536
+#define STDIN_CHUNK 512     // read-ahead on a seekable stdin, seeked back per line
+
+enum { INPUT_INTERACTIVE, INPUT_BUFFER, INPUT_STREAM };
+
+static int input_mode = INPUT_INTERACTIVE;
+
+// INPUT_BUFFER: an mmap'd script or a -c string
+static const char* input_buffer = NULL;
+static size_t input_length = 0;
+static size_t input_pos = 0;
+static int input_mapped = 0;
+
+// INPUT_STREAM: a pipe or other unmappable file read in chunks
+static int input_fd = -1;
+static char* stream_buffer = NULL;
+static size_t stream_start = 0; // first unread byte
+static size_t stream_end = 0;   // end of valid data
+static size_t stream_size = 0;  // allocated size of stream_buffer
+static int stream_eof = 0;
+static int stream_shared = 0;   // stdin, which commands we run read too
+static int stream_seekable = 0;
+
+void input_interactive() {
+    input_mode = INPUT_INTERACTIVE;
+}
+
+int input_is_interactive() {
+    return input_mode == INPUT_INTERACTIVE;
+}
+
+void input_open_string(const char* text) {
+    input_mode = INPUT_BUFFER;
+    input_buffer = text;
+    input_length = strlen(text);
+    input_pos = 0;
+    input_mapped = 0;
+}
+
+void input_open_fd(int fd) {
+    input_mode = INPUT_STREAM;
+    input_fd = fd;
+    stream_size = INPUT_CHUNK;
+    stream_buffer = malloc(stream_size);
+    stream_start = 0;
+    stream_end = 0;
+    stream_eof = 0;
+    stream_shared = (fd == STDIN_FILENO);
+    stream_seekable = lseek(fd, 0, SEEK_CUR) >= 0;
+}
+
+// Map a script file; files that cannot be mapped (fifos, /dev/stdin) are streamed
+int input_open_file(const char* path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        input_mode = INPUT_BUFFER;
+        input_length = st.st_size;
+        input_pos = 0;
+        
+        if (st.st_size == 0) {
+            input_buffer = "";
+            input_mapped = 0;
+            close(fd);
+            return 0;
+        }
+        
+        void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            input_buffer = map;
+            input_mapped = 1;
+            close(fd);
+            return 0;
+        }
+    }
+    
+    input_open_fd(fd);
+    return 0;
+}
+
+void input_close() {
+    if (input_mode == INPUT_BUFFER && input_mapped) {
+        munmap((void*)input_buffer, input_length);
+    } else if (input_mode == INPUT_STREAM) {
+        free(stream_buffer);
+        stream_buffer = NULL;
+        if (input_fd > STDERR_FILENO) close(input_fd);
+    }
+    input_mapped = 0;
+}
+
+static char* buffer_read_line() {
+    if (input_pos >= input_length) return NULL;
+    
+    const char* start = input_buffer + input_pos;
+    const char* newline = memchr(start, '\n', input_length - input_pos);
+    size_t len = newline ? (size_t)(newline - start) : input_length - input_pos;
+    
+    input_pos += len + (newline ? 1 : 0);
+    return strndup(start, len);
+}
+
+static char* stream_read_line() {
+    while (1) {
+        char* start = stream_buffer + stream_start;
+        char* newline = memchr(start, '\n', stream_end - stream_start);
+        if (newline != NULL) {
+            size_t len = newline - start;
+            stream_start += len + 1;
+            char* line = strndup(start, len);
+            
+            // Leave what follows the line on stdin for the commands it runs
+            if (stream_shared && stream_start < stream_end) {
+                lseek(input_fd, -(off_t)(stream_end - stream_start), SEEK_CUR);
+                stream_start = stream_end = 0;
+            }
+            return line;
+        }
+        
+        if (stream_eof) {
+            if (stream_start == stream_end) return NULL;
+            char* line = strndup(start, stream_end - stream_start);
+            stream_start = stream_end;
+            return line;
+        }
+        
+        // Slide the partial line to the front, growing for very long lines
+        memmove(stream_buffer, start, stream_end - stream_start);
+        stream_end -= stream_start;
+        stream_start = 0;
+        if (stream_size - stream_end < INPUT_CHUNK / 2) {
+            stream_size *= 2;
+            stream_buffer = realloc(stream_buffer, stream_size);
+        }
+        
+        // A stdin pipe cannot be seeked back, so it goes a byte at a time
+        size_t want = stream_size - stream_end;
+        if (stream_shared) want = stream_seekable ? STDIN_CHUNK : 1;
+        ssize_t n = read(input_fd, stream_buffer + stream_end, want);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            perror("read");
+            stream_eof = 1;
+        } else if (n == 0) {
+            stream_eof = 1;
+        } else {
+            stream_end += n;
+        }
+    }
+}
+
+// Read one line without its newline, or NULL at end of input. The prompt
+// is only shown in interactive mode. The caller frees the line.
+char* input_read_line(const char* prompt) {
+    switch (input_mode) {
+        case INPUT_BUFFER:
+            return buffer_read_line();
+        case INPUT_STREAM:
+            return stream_read_line();
+        default:
+            return event_read_line(prompt);
+    }
+}
+
+// Read everything left on fd into a malloc'd buffer; *length gets its size
+char* input_slurp(int fd, size_t* length) {
+    size_t capacity = INPUT_CHUNK;
+    char* data = malloc(capacity);
+    ssize_t n;
+    
+    *length = 0;
+    while ((n = read(fd, data + *length, capacity - *length)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            break;
+        }
+        *length += n;
+        if (*length == capacity) {
+            capacity *= 2;
+            data = realloc(data, capacity);
+        }
+    }
+    return data;
+}
+
+// Read the next command line; interactive lines go into the history
+char* read_cmd(char* prompt) {
+    char* line = input_read_line(prompt);
+    // ! lines are recorded once expanded, by handle_history_execution()
+    if (line != NULL && line[0] != '\0' && line[0] != '!' && input_is_interactive()) {
+        add_to_history(line);
+    }
+    return line;
+}
@@ -1,73 +1,667 @@
 #include "shell.h"
+#include <errno.h>
+#include <sched.h>
+#include <termios.h>
+
+// Job table and job control.
+//
+// Jobs are indexed twice: job_slots[id - 1] answers %n, and a pid -> job
+// hash (linear probing with backward-shift deletion) matches every pid
+// reaped by waitpid() to its job in O(1), however many jobs are running.
+// Freed job ids go on a min-heap so the lowest one is handed out again.
+//
+// On a terminal every pipeline runs in its own process group. The
+// foreground group owns the terminal while it runs; the shell takes it
+// back, with its saved modes, once the job exits or stops.
+//
+// Background jobs go through a small scheduler: with JOBS_MAX set, at
+// most that many run at once and the rest wait in a FIFO queue, holding
+// a copy of their expanded commands, until the reaper frees a slot.
+// JOB_NICE and JOB_CPUS (a list like 0-3,6) set the nice value and CPU
+// affinity of the background jobs submitted while they are set.
 
-// Global job list
-job_t job_list[MAX_JOBS];
 int job_count = 0;
+int job_control = 0;
+
+// Process ID of the last background job started, for $!
+pid_t last_background_pid = 0;
+
+static job_t** job_slots = NULL;
+static int job_slots_capacity = 0;
+static int job_slots_used = 0;  // highest job id handed out so far
+static int current_job_id = 0;  // default job for fg/bg (%+)
+static int running_jobs = 0;    // jobs in the table in JOB_RUNNING
+
+// Background jobs waiting for a slot, oldest first
+static job_t* queue_head = NULL;
+static job_t* queue_tail = NULL;
+
+// Ids below job_slots_used that are free again
+static int* free_ids = NULL;
+static int free_id_count = 0;
+static int free_id_capacity = 0;
+
+typedef struct {
+    pid_t pid; // 0 = empty slot
+    job_t* job;
+} pid_entry_t;
+
+static pid_entry_t* pid_table = NULL;
+static unsigned int pid_capacity = 0; // power of two
+static unsigned int pid_count = 0;
+
+// Jobs that finished or stopped since the last update_jobs()
+static job_t* notify_head = NULL;
+static job_t* notify_tail = NULL;
+
+static pid_t shell_pgid;
+static struct termios shell_tmodes;
+
+// Signals the interactive shell ignores and its children get back
+static const int job_signals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU};
+#define NUM_JOB_SIGNALS (int)(sizeof(job_signals) / sizeof(job_signals[0]))
+
+static unsigned int pid_hash(pid_t pid) {
+    return (unsigned int)pid * 2654435761u;
+}
+
+static void pid_insert(pid_t pid, job_t* job);
+
+static void pid_grow() {
+    pid_entry_t* old = pid_table;
+    unsigned int old_capacity = pid_capacity;
+    
+    pid_capacity = old_capacity ? old_capacity * 2 : 64;
+    pid_table = calloc(pid_capacity, sizeof(pid_entry_t));
+    pid_count = 0;
+    for (unsigned int i = 0; i < old_capacity; i++) {
+        if (old[i].pid != 0) pid_insert(old[i].pid, old[i].job);
+    }
+    free(old);
+}
+
+static void pid_insert(pid_t pid, job_t* job) {
+    if ((pid_count + 1) * 2 > pid_capacity) pid_grow();
+    
+    unsigned int mask = pid_capacity - 1;
+    unsigned int i = pid_hash(pid) & mask;
+    while (pid_table[i].pid != 0 && pid_table[i].pid != pid) i = (i + 1) & mask;
+    if (pid_table[i].pid == 0) pid_count++;
+    pid_table[i].pid = pid;
+    pid_table[i].job = job;
+}
+
+job_t* find_job_by_pid(pid_t pid) {
+    if (pid_capacity == 0) return NULL;
+    
+    unsigned int mask = pid_capacity - 1;
+    for (unsigned int i = pid_hash(pid) & mask; pid_table[i].pid != 0; i = (i + 1) & mask) {
+        if (pid_table[i].pid == pid) return pid_table[i].job;
+    }
+    return NULL;
+}
+
+// Delete pid and shift later members of its probe run back into the hole,
+// so lookups never need tombstones
+static void pid_remove(pid_t pid) {
+    if (pid_capacity == 0) return;
+    
+    unsigned int mask = pid_capacity - 1;
+    unsigned int hole = pid_hash(pid) & mask;
+    while (pid_table[hole].pid != 0 && pid_table[hole].pid != pid) hole = (hole + 1) & mask;
+    if (pid_table[hole].pid == 0) return;
+    
+    for (unsigned int i = (hole + 1) & mask; pid_table[i].pid != 0; i = (i + 1) & mask) {
+        unsigned int home = pid_hash(pid_table[i].pid) & mask;
+        // The entry may move back unless its home lies between hole and i
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            pid_table[hole] = pid_table[i];
+            hole = i;
+        }
+    }
+    pid_table[hole].pid = 0;
+    pid_table[hole].job = NULL;
+    pid_count--;
+}
+
+static void push_free_id(int id) {
+    if (free_id_count == free_id_capacity) {
+        free_id_capacity = free_id_capacity ? free_id_capacity * 2 : 16;
+        free_ids = realloc(free_ids, free_id_capacity * sizeof(int));
+    }
+    int i = free_id_count++;
+    while (i > 0 && free_ids[(i - 1) / 2] > id) {
+        free_ids[i] = free_ids[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    free_ids[i] = id;
+}
+
+static int pop_free_id() {
+    int id = free_ids[0];
+    int last = free_ids[--free_id_count];
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= free_id_count) break;
+        if (child + 1 < free_id_count && free_ids[child + 1] < free_ids[child]) child++;
+        if (free_ids[child] >= last) break;
+        free_ids[i] = free_ids[child];
+        i = child;
+    }
+    if (free_id_count > 0) free_ids[i] = last;
+    return id;
+}
 
 // Initialize job list
 void init_jobs() {
-    for (int i = 0; i < MAX_JOBS; i++) {
-        job_list[i].pid = -1;
-        job_list[i].command = NULL;
-        job_list[i].job_id = -1;
-        job_list[i].status = -1;
-    }
     job_count = 0;
+    job_slots_used = 0;
+    current_job_id = 0;
+    running_jobs = 0;
+    free_id_count = 0;
+    notify_head = notify_tail = NULL;
+    queue_head = queue_tail = NULL;
 }
 
-// Add a new background job
-void add_job(pid_t pid, char* command) {
-    if (job_count >= MAX_JOBS) {
-        printf("Job list full. Cannot add more jobs.\n");
+// Take over the terminal when the shell is interactive: become a process
+// group leader in the foreground and ignore the job-control signals that
+// are meant for the jobs.
+void init_job_control() {
+    if (!isatty(STDIN_FILENO)) return;
+    
+    // If started in the background, wait until we are moved to the foreground
+    while (tcgetpgrp(STDIN_FILENO) != (shell_pgid = getpgrp())) {
+        kill(-shell_pgid, SIGTTIN);
+    }
+    
+    for (int i = 0; i < NUM_JOB_SIGNALS; i++) {
+        signal(job_signals[i], SIG_IGN);
+    }
+    
+    shell_pgid = getpid();
+    if (getpgrp() != shell_pgid && setpgid(0, shell_pgid) < 0) {
+        perror("setpgid");
         return;
     }
+    tcsetpgrp(STDIN_FILENO, shell_pgid);
+    tcgetattr(STDIN_FILENO, &shell_tmodes);
+    job_control = 1;
+}
+
+// The signals a job's processes must have reset to SIG_DFL
+void job_control_signals(sigset_t* set) {
+    sigemptyset(set);
+    for (int i = 0; i < NUM_JOB_SIGNALS; i++) {
+        sigaddset(set, job_signals[i]);
+    }
+}
+
+// Undo the shell's signal setup in a forked child: the event loop's
+// blocked SIGCHLD and init_job_control()'s ignored signals
+void restore_job_signals() {
+    sigset_t mask;
+    if (events_child_mask(&mask)) sigprocmask(SIG_SETMASK, &mask, NULL);
     
-    for (int i = 0; i < MAX_JOBS; i++) {
-        if (job_list[i].pid == -1) {
-            job_list[i].pid = pid;
-            job_list[i].command = strdup(command);
-            job_list[i].job_id = i + 1;
-            job_list[i].status = 0; // running
-            job_count++;
-            printf("[%d] %d\n", job_list[i].job_id, pid);
-            break;
+    if (!job_control) return;
+    
+    for (int i = 0; i < NUM_JOB_SIGNALS; i++) {
+        signal(job_signals[i], SIG_DFL);
+    }
+}
+
+static void take_terminal() {
+    tcsetpgrp(STDIN_FILENO, shell_pgid);
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &shell_tmodes);
+}
+
+// Build a job from the pids started for it; entries <= 0 never started
+// and hold minus their exit status, as spawn_external() returns them
+job_t* new_job(pid_t* pids, int num_pids, pid_t last_pid) {
+    job_t* job = malloc(sizeof(job_t) + num_pids * sizeof(pid_t));
+    job->pgid = -1;
+    job->last_pid = last_pid;
+    job->command = NULL;
+    job->job_id = 0;
+    job->status = last_pid > 0 ? 0 : -last_pid;
+    job->signaled = 0;
+    job->live = 0;
+    job->notify = 0;
+    job->next_notify = NULL;
+    job->nice = 0;
+    job->cpus = NULL;
+    job->arena = NULL;
+    job->commands = NULL;
+    job->num_commands = 0;
+    job->next_queued = NULL;
+    job->num_pids = 0;
+    
+    for (int i = 0; i < num_pids; i++) {
+        if (pids[i] <= 0) continue;
+        if (job->pgid < 0) job->pgid = pids[i];
+        job->pids[job->num_pids++] = pids[i];
+        job->live++;
+    }
+    job->state = job->live > 0 ? JOB_RUNNING : JOB_DONE;
+    return job;
+}
+
+void free_job(job_t* job) {
+    if (job->arena != NULL) {
+        arena_free(job->arena);
+        free(job->arena);
+    }
+    free(job->command);
+    free(job->cpus);
+    free(job);
+}
+
+// Change a job's state, keeping running_jobs in step for table jobs
+static void set_job_state(job_t* job, int state) {
+    if (job->job_id > 0) {
+        if (job->state == JOB_RUNNING) running_jobs--;
+        if (state == JOB_RUNNING) running_jobs++;
+    }
+    job->state = state;
+}
+
+static void queue_notify(job_t* job) {
+    if (job->notify) return;
+    
+    job->notify = 1;
+    job->next_notify = NULL;
+    if (notify_tail != NULL) {
+        notify_tail->next_notify = job;
+    } else {
+        notify_head = job;
+    }
+    notify_tail = job;
+}
+
+// Enter a job into the job table and return its id
+int add_job(job_t* job, char* command) {
+    if (job_slots_used == job_slots_capacity) {
+        job_slots_capacity = job_slots_capacity ? job_slots_capacity * 2 : 16;
+        job_slots = realloc(job_slots, job_slots_capacity * sizeof(job_t*));
+    }
+    
+    int id = free_id_count > 0 ? pop_free_id() : ++job_slots_used;
+    job_slots[id - 1] = job;
+    job->job_id = id;
+    job->command = strdup(command);
+    for (int i = 0; i < job->num_pids; i++) {
+        if (job->pids[i] > 0) pid_insert(job->pids[i], job);
+    }
+    job_count++;
+    if (job->state == JOB_RUNNING) running_jobs++;
+    current_job_id = id;
+    return id;
+}
+
+static void unqueue_job(job_t* job) {
+    job_t** link = &queue_head;
+    queue_tail = NULL;
+    while (*link != NULL) {
+        if (*link == job) {
+            *link = job->next_queued;
+            continue;
         }
+        queue_tail = *link;
+        link = &(*link)->next_queued;
     }
 }
 
-// Remove a job by PID
-void remove_job(pid_t pid) {
-    for (int i = 0; i < MAX_JOBS; i++) {
-        if (job_list[i].pid == pid) {
-            if (job_list[i].command != NULL) {
-                free(job_list[i].command);
+// Drop a job from the table and free it
+void remove_job(job_t* job) {
+    if (job->state == JOB_QUEUED) unqueue_job(job);
+    set_job_state(job, JOB_DONE);
+    
+    for (int i = 0; i < job->num_pids; i++) {
+        if (job->pids[i] > 0) pid_remove(job->pids[i]);
+    }
+    
+    if (job->notify) {
+        job_t** link = &notify_head;
+        notify_tail = NULL;
+        while (*link != NULL) {
+            if (*link == job) {
+                *link = job->next_notify;
+                continue;
             }
-            job_list[i].pid = -1;
-            job_list[i].command = NULL;
-            job_list[i].job_id = -1;
-            job_list[i].status = -1;
-            job_count--;
+            notify_tail = *link;
+            link = &(*link)->next_notify;
+        }
+    }
+    
+    int id = job->job_id;
+    job_slots[id - 1] = NULL;
+    if (id == job_slots_used) {
+        job_slots_used--;
+    } else {
+        push_free_id(id);
+    }
+    if (current_job_id == id) current_job_id = 0;
+    job_count--;
+    free_job(job);
+}
+
+static job_t* current_job() {
+    if (current_job_id > 0 && job_slots[current_job_id - 1] != NULL) {
+        return job_slots[current_job_id - 1];
+    }
+    for (int id = job_slots_used; id > 0; id--) {
+        if (job_slots[id - 1] != NULL) return job_slots[id - 1];
+    }
+    return NULL;
+}
+
+// Apply a waitpid() status reported for pid, one of job's processes
+static void job_record(job_t* job, pid_t pid, int status) {
+    if (WIFSTOPPED(status)) {
+        set_job_state(job, JOB_STOPPED);
+        return;
+    }
+    if (WIFCONTINUED(status)) {
+        if (job->state != JOB_DONE) set_job_state(job, JOB_RUNNING);
+        return;
+    }
+    
+    for (int i = 0; i < job->num_pids; i++) {
+        if (job->pids[i] == pid) {
+            job->pids[i] = -1;
+            job->live--;
             break;
         }
     }
+    if (job->job_id > 0) pid_remove(pid);
+    
+    if (pid == job->last_pid) {
+        job->signaled = WIFSIGNALED(status);
+        job->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+    if (job->live == 0) set_job_state(job, JOB_DONE);
+}
+
+// Wait until every process of job has exited or the job stops. A
+// foreground job is given the terminal meanwhile. Resource usage of the
+// reaped processes is added to *usage when it is not NULL.
+int wait_for_job(job_t* job, int foreground, struct rusage* usage) {
+    foreground = foreground && job_control;
+    if (foreground && job->live > 0) tcsetpgrp(STDIN_FILENO, job->pgid);
+    
+    for (int i = 0; i < job->num_pids && job->state != JOB_STOPPED; i++) {
+        pid_t pid = job->pids[i];
+        if (pid <= 0) continue;
+        
+        int status;
+        struct rusage ru;
+        if (wait4(pid, &status, WUNTRACED, &ru) < 0) {
+            if (errno == EINTR) {
+                i--;
+                continue;
+            }
+            // Reaped elsewhere; nothing more to learn about it
+            job_record(job, pid, 0);
+            continue;
+        }
+        
+        // A stage that touched the terminal before it was handed over was
+        // stopped by the kernel, not by the user
+        if (foreground && WIFSTOPPED(status) && (WSTOPSIG(status) == SIGTTIN || WSTOPSIG(status) == SIGTTOU)) {
+            kill(-job->pgid, SIGCONT);
+            i--;
+            continue;
+        }
+        
+        if (usage != NULL && !WIFSTOPPED(status)) {
+            timeradd(&usage->ru_utime, &ru.ru_utime, &usage->ru_utime);
+            timeradd(&usage->ru_stime, &ru.ru_stime, &usage->ru_stime);
+            if (ru.ru_maxrss > usage->ru_maxrss) usage->ru_maxrss = ru.ru_maxrss;
+        }
+        job_record(job, pid, status);
+    }
+    
+    if (foreground) take_terminal();
+    if (job->state == JOB_STOPPED) {
+        if (job->job_id > 0) current_job_id = job->job_id;
+        return 128 + SIGTSTP;
+    }
+    return job->status;
 }
 
-// Update job status and remove completed jobs
-void update_jobs() {
+// JOBS_MAX, or 0 for no limit
+static int jobs_max() {
+    char* value = get_variable("JOBS_MAX");
+    return value != NULL ? atoi(value) : 0;
+}
+
+// Parse a CPU list such as 0-3,6 into set; -1 if malformed or empty
+static int parse_cpu_list(char* list, cpu_set_t* set) {
+    CPU_ZERO(set);
+    char* p = list;
+    
+    while (*p != '\0') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p || first < 0) return -1;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) return -1;
+        }
+        if (last >= CPU_SETSIZE) return -1;
+        for (long cpu = first; cpu <= last; cpu++) CPU_SET(cpu, set);
+        
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return -1;
+        }
+        p = end;
+    }
+    return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+// Give a started job's processes its nice value and CPU affinity. They
+// are set right after the processes start; posix_spawn has no attribute
+// for either.
+static void apply_job_attributes(job_t* job) {
+    cpu_set_t set;
+    int have_cpus = job->cpus != NULL && parse_cpu_list(job->cpus, &set) == 0;
+    
+    for (int i = 0; i < job->num_pids; i++) {
+        if (job->pids[i] <= 0) continue;
+        if (job->nice != 0) setpriority(PRIO_PROCESS, job->pids[i], job->nice);
+        if (have_cpus) sched_setaffinity(job->pids[i], sizeof(set), &set);
+    }
+}
+
+// Deep-copy expanded commands into arena so a queued job outlives its line
+static command_t* copy_commands(arena_t* arena, command_t* commands, int n) {
+    command_t* copy = arena_alloc(arena, n * sizeof(command_t));
+    
+    for (int i = 0; i < n; i++) {
+        command_t* cmd = &copy[i];
+        *cmd = commands[i];
+        
+        int argc = 0;
+        while (commands[i].args[argc] != NULL) argc++;
+        cmd->argc = argc;
+        cmd->args = arena_alloc(arena, (argc + 1) * sizeof(char*));
+        for (int j = 0; j < argc; j++) {
+            cmd->args[j] = arena_strdup(arena, commands[i].args[j]);
+        }
+        cmd->args[argc] = NULL;
+        
+        if (cmd->input_file) cmd->input_file = arena_strdup(arena, cmd->input_file);
+        if (cmd->output_file) cmd->output_file = arena_strdup(arena, cmd->output_file);
+        if (cmd->here_text) cmd->here_text = arena_strdup(arena, cmd->here_text);
+        if (cmd->num_extra_outputs > 0) {
+            cmd->extra_outputs = arena_alloc(arena, cmd->num_extra_outputs * sizeof(output_target_t));
+            for (int j = 0; j < cmd->num_extra_outputs; j++) {
+                cmd->extra_outputs[j].file = arena_strdup(arena, commands[i].extra_outputs[j].file);
+                cmd->extra_outputs[j].append = commands[i].extra_outputs[j].append;
+            }
+        }
+    }
+    return copy;
+}
+
+// Start a queued job in place: the running job takes over its id
+static job_t* start_queued(job_t* queued) {
+    int id = queued->job_id;
+    job_t* job = start_pipeline(queued->commands, queued->num_commands);
+    if (job == NULL) job = new_job(NULL, 0, -1);
+    
+    job->job_id = id;
+    job->command = queued->command;
+    job->nice = queued->nice;
+    job->cpus = queued->cpus;
+    queued->command = NULL;
+    queued->cpus = NULL;
+    free_job(queued);
+    
+    job_slots[id - 1] = job;
+    for (int i = 0; i < job->num_pids; i++) {
+        pid_insert(job->pids[i], job);
+    }
+    if (job->state == JOB_RUNNING) {
+        running_jobs++;
+        last_background_pid = job->last_pid > 0 ? job->last_pid : job->pgid;
+        apply_job_attributes(job);
+    } else {
+        queue_notify(job); // nothing could be started
+    }
+    return job;
+}
+
+// Start queued jobs while there are free slots
+static void schedule_jobs() {
+    int max = jobs_max();
+    
+    while (queue_head != NULL && (max <= 0 || running_jobs < max)) {
+        job_t* job = queue_head;
+        queue_head = job->next_queued;
+        if (queue_head == NULL) queue_tail = NULL;
+        start_queued(job);
+    }
+}
+
+// Run a background job now, or queue it while JOBS_MAX jobs are running
+void submit_job(command_t* commands, int num_commands, char* command) {
+    int max = jobs_max();
+    job_t* job;
+    
+    // Finished jobs free their slots
+    if (max > 0) cleanup_zombies();
+    
+    // A compound command's tree lives only as long as its line, so it
+    // cannot wait in the queue and starts at once
+    int compound = 0;
+    for (int i = 0; i < num_commands; i++) {
+        if (commands[i].compound != NULL) compound = 1;
+    }
+    
+    if (max > 0 && running_jobs >= max && !compound) {
+        job = new_job(NULL, 0, -1);
+        job->state = JOB_QUEUED;
+        job->status = 0;
+        job->arena = malloc(sizeof(arena_t));
+        arena_init(job->arena);
+        job->commands = copy_commands(job->arena, commands, num_commands);
+        job->num_commands = num_commands;
+    } else {
+        job = start_pipeline(commands, num_commands);
+        if (job == NULL) return;
+        if (job->live == 0) {
+            free_job(job);
+            return;
+        }
+    }
+    
+    char* nice_value = get_variable("JOB_NICE");
+    char* cpus = get_variable("JOB_CPUS");
+    cpu_set_t set;
+    if (nice_value != NULL) job->nice = atoi(nice_value);
+    if (cpus != NULL && cpus[0] != '\0') {
+        if (parse_cpu_list(cpus, &set) == 0) {
+            job->cpus = strdup(cpus);
+        } else {
+            fprintf(stderr, "JOB_CPUS: %s: invalid CPU list\n", cpus);
+        }
+    }
+    
+    int id = add_job(job, command);
+    if (job->state == JOB_QUEUED) {
+        if (queue_tail != NULL) {
+            queue_tail->next_queued = job;
+        } else {
+            queue_head = job;
+        }
+        queue_tail = job;
+        printf("[%d] queued\n", id);
+    } else {
+        apply_job_attributes(job);
+        last_background_pid = job->last_pid > 0 ? job->last_pid : job->pgid;
+        printf("[%d] %d\n", id, last_background_pid);
+    }
+}
+
+// Block until one child changes state, record it and refill free slots.
+// Returns -1 when there are no children left.
+static int reap_one() {
     int status;
+    pid_t pid = waitpid(-1, &status, WUNTRACED);
+    if (pid < 0) return errno == EINTR ? 0 : -1;
+    
+    job_t* job = find_job_by_pid(pid);
+    if (job != NULL) job_record(job, pid, status);
+    schedule_jobs();
+    return 0;
+}
+
+// Reap every child whose state changed and record it on its job; jobs
+// that finished or stopped are queued for update_jobs() to report.
+// Children that belong to no job (foreground jobs are waited for
+// directly) are just reaped. Returns the number of jobs queued.
+int cleanup_zombies() {
+    int status;
+    int queued = 0;
     pid_t pid;
     
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-        for (int i = 0; i < MAX_JOBS; i++) {
-            if (job_list[i].pid == pid) {
-                if (WIFEXITED(status)) {
-                    printf("[%d] Done %s\n", job_list[i].job_id, job_list[i].command);
-                } else if (WIFSIGNALED(status)) {
-                    printf("[%d] Killed %s\n", job_list[i].job_id, job_list[i].command);
-                }
-                remove_job(pid);
-                break;
-            }
+    while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0) {
+        job_t* job = find_job_by_pid(pid);
+        if (job == NULL) continue;
+        
+        int before = job->state;
+        job_record(job, pid, status);
+        if (job->state == before || job->state == JOB_RUNNING || job->notify) continue;
+        
+        queue_notify(job);
+        queued++;
+    }
+    schedule_jobs();
+    return queued;
+}
+
+// Reap children and report jobs that finished or stopped since last time
+void update_jobs() {
+    cleanup_zombies();
+    
+    while (notify_head != NULL) {
+        job_t* job = notify_head;
+        notify_head = job->next_notify;
+        if (notify_head == NULL) notify_tail = NULL;
+        job->notify = 0;
+        
+        if (job->state == JOB_DONE) {
+            printf("[%d] %s %s\n", job->job_id, job->signaled ? "Killed" : "Done", job->command);
+            remove_job(job);
+            shell_stats.jobs_reaped++;
+        } else if (job->state == JOB_STOPPED) {
+            printf("[%d] Stopped %s\n", job->job_id, job->command);
+            current_job_id = job->job_id;
         }
     }
 }
@@ -80,27 +674,232 @@ void print_jobs() {
     }
     
     printf("Active jobs:\n");
-    for (int i = 0; i < MAX_JOBS; i++) {
-        if (job_list[i].pid != -1) {
-            printf("[%d] %d %s", job_list[i].job_id, job_list[i].pid, job_list[i].command);
-            if (job_list[i].status == 0) {
-                printf(" (running)");
-            } else if (job_list[i].status == 1) {
-                printf(" (completed)");
-            } else if (job_list[i].status == 2) {
-                printf(" (stopped)");
+    for (int id = 1; id <= job_slots_used; id++) {
+        job_t* job = job_slots[id - 1];
+        if (job == NULL) continue;
+        
+        if (job->state == JOB_QUEUED) {
+            printf("[%d] - %s (queued)\n", id, job->command);
+            continue;
+        }
+        printf("[%d] %d %s", id, job->pgid, job->command);
+        if (job->state == JOB_RUNNING) {
+            printf(" (running)");
+        } else if (job->state == JOB_DONE) {
+            printf(" (completed)");
+        } else if (job->state == JOB_STOPPED) {
+            printf(" (stopped)");
+        }
+        printf("\n");
+    }
+}
+
+void execute_jobs() {
+    update_jobs();
+    print_jobs();
+}
+
+// Resolve %n, %%, %+ or a bare job number; NULL spec means the current job
+static job_t* find_job(char* spec, char* builtin) {
+    if (spec == NULL || strcmp(spec, "%%") == 0 || strcmp(spec, "%+") == 0) {
+        job_t* job = current_job();
+        if (job == NULL) fprintf(stderr, "%s: no current job\n", builtin);
+        return job;
+    }
+    
+    char* end;
+    long id = strtol(spec[0] == '%' ? spec + 1 : spec, &end, 10);
+    if (*end != '\0' || id < 1 || id > job_slots_used || job_slots[id - 1] == NULL) {
+        fprintf(stderr, "%s: %s: no such job\n", builtin, spec);
+        return NULL;
+    }
+    return job_slots[id - 1];
+}
+
+// Send sig to every process of a job
+static int signal_job(job_t* job, int sig) {
+    if (job_control) return kill(-job->pgid, sig);
+    
+    int result = 0;
+    for (int i = 0; i < job->num_pids; i++) {
+        if (job->pids[i] > 0 && kill(job->pids[i], sig) < 0) result = -1;
+    }
+    return result;
+}
+
+// fg [%n]: continue a job in the foreground and wait for it
+int execute_fg(char** args) {
+    if (!job_control) {
+        fprintf(stderr, "fg: no job control\n");
+        return 1;
+    }
+    job_t* job = find_job(args[1], "fg");
+    if (job == NULL) return 1;
+    
+    printf("%s\n", job->command);
+    fflush(stdout);
+    
+    // A queued job skips the queue
+    if (job->state == JOB_QUEUED) {
+        unqueue_job(job);
+        job = start_queued(job);
+    }
+    
+    if (job->state != JOB_DONE) tcsetpgrp(STDIN_FILENO, job->pgid);
+    if (job->state == JOB_STOPPED) {
+        signal_job(job, SIGCONT);
+        set_job_state(job, JOB_RUNNING);
+    }
+    
+    int status = wait_for_job(job, 1, NULL);
+    if (job->state == JOB_STOPPED) {
+        printf("\n[%d] Stopped %s\n", job->job_id, job->command);
+        return status;
+    }
+    remove_job(job);
+    schedule_jobs();
+    return status;
+}
+
+// bg [%n]: continue a stopped job in the background
+int execute_bg(char** args) {
+    if (!job_control) {
+        fprintf(stderr, "bg: no job control\n");
+        return 1;
+    }
+    job_t* job = find_job(args[1], "bg");
+    if (job == NULL) return 1;
+    
+    if (job->state != JOB_STOPPED) {
+        fprintf(stderr, "bg: job %d already in background\n", job->job_id);
+        return 0;
+    }
+    signal_job(job, SIGCONT);
+    set_job_state(job, JOB_RUNNING);
+    printf("[%d] %s &\n", job->job_id, job->command);
+    return 0;
+}
+
+// wait [%n | pid ...]: wait for the given jobs, or for every running job
+int execute_wait(char** args) {
+    if (args[1] == NULL) {
+        // Reap in whatever order jobs finish so queued ones start early
+        schedule_jobs();
+        while (running_jobs > 0 || queue_head != NULL) {
+            if (reap_one() < 0) break;
+        }
+        for (int id = 1; id <= job_slots_used; id++) {
+            job_t* job = job_slots[id - 1];
+            if (job != NULL && job->state == JOB_DONE) {
+                remove_job(job);
+                shell_stats.jobs_reaped++;
             }
-            printf("\n");
         }
+        return 0;
     }
+    
+    int status = 0;
+    for (int i = 1; args[i] != NULL; i++) {
+        job_t* job;
+        if (args[i][0] == '%') {
+            job = find_job(args[i], "wait");
+        } else {
+            job = find_job_by_pid(atoi(args[i]));
+            if (job == NULL) fprintf(stderr, "wait: pid %s is not a child of this shell\n", args[i]);
+        }
+        if (job == NULL) {
+            status = 127;
+            continue;
+        }
+        
+        int id = job->job_id;
+        while (job->state == JOB_QUEUED) {
+            if (reap_one() < 0) break;
+            job = job_slots[id - 1];
+        }
+        
+        status = wait_for_job(job, 0, NULL);
+        if (job->state == JOB_DONE) {
+            remove_job(job);
+            shell_stats.jobs_reaped++;
+        }
+    }
+    return status;
 }
 
-// Clean up zombie processes
-void cleanup_zombies() {
-    int status;
-    pid_t pid;
+// Signal number for a name (KILL, SIGKILL) or number; -1 if unknown
+static int parse_signal(char* name) {
+    static const struct {
+        char* name;
+        int number;
+    } signals[] = {
+        {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+        {"USR1", SIGUSR1}, {"USR2", SIGUSR2}, {"PIPE", SIGPIPE}, {"ALRM", SIGALRM},
+        {"TERM", SIGTERM}, {"CHLD", SIGCHLD}, {"CONT", SIGCONT}, {"STOP", SIGSTOP},
+        {"TSTP", SIGTSTP}, {"TTIN", SIGTTIN}, {"TTOU", SIGTTOU}, {NULL, 0}
+    };
+    
+    char* end;
+    long number = strtol(name, &end, 10);
+    if (end != name && *end == '\0') return (number >= 0 && number < NSIG) ? (int)number : -1;
     
-    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
-        // Zombie process reaped, no need to print anything
+    if (strncmp(name, "SIG", 3) == 0) name += 3;
+    for (int i = 0; signals[i].name != NULL; i++) {
+        if (strcmp(signals[i].name, name) == 0) return signals[i].number;
+    }
+    return -1;
+}
+
+// kill [-SIGNAL] %n | pid ...
+int execute_kill(char** args) {
+    int sig = SIGTERM;
+    int i = 1;
+    
+    if (args[1] != NULL && args[1][0] == '-' && args[1][1] != '\0') {
+        sig = parse_signal(args[1] + 1);
+        if (sig < 0) {
+            fprintf(stderr, "kill: %s: invalid signal specification\n", args[1] + 1);
+            return 2;
+        }
+        i = 2;
+    }
+    if (args[i] == NULL) {
+        fprintf(stderr, "kill: usage: kill [-SIGNAL] %%job | pid ...\n");
+        return 2;
+    }
+    
+    int status = 0;
+    for (; args[i] != NULL; i++) {
+        if (args[i][0] == '%') {
+            job_t* job = find_job(args[i], "kill");
+            if (job == NULL) {
+                status = 1;
+                continue;
+            }
+            if (job->state == JOB_QUEUED) {
+                // Never started: drop it from the queue
+                if (sig != 0 && sig != SIGCONT) remove_job(job);
+                continue;
+            }
+            if (signal_job(job, sig) < 0) {
+                perror("kill");
+                status = 1;
+            } else if (job->state == JOB_STOPPED && sig != SIGCONT) {
+                // A stopped job only acts on the signal once continued
+                signal_job(job, SIGCONT);
+            }
+            continue;
+        }
+        
+        char* end;
+        long pid = strtol(args[i], &end, 10);
+        if (end == args[i] || *end != '\0') {
+            fprintf(stderr, "kill: %s: arguments must be process or job IDs\n", args[i]);
+            status = 1;
+        } else if (kill((pid_t)pid, sig) < 0) {
+            perror("kill");
+            status = 1;
+        }
     }
+    return status;
 }
@@ -1,8 +1,28 @@
 #include "shell.h"
 
-int main() {
+int main(int argc, char** argv) {
     char* cmdline;
-    pipeline_t* pipeline;
+    int status = 0;
+
+    // Pick the input: -c string, script file, piped stdin or a terminal
+    if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "myshell: -c: option requires an argument\n");
+            return 2;
+        }
+        input_open_string(argv[2]);
+    } else if (argc > 1) {
+        if (input_open_file(argv[1]) < 0) {
+            perror(argv[1]);
+            return 127;
+        }
+    } else if (!isatty(STDIN_FILENO)) {
+        input_open_fd(STDIN_FILENO);
+    } else {
+        input_interactive();
+    }
+    int interactive = input_is_interactive();
+    int event_loop = 0;
 
     // Initialize job system
     init_jobs();
@@ -10,40 +30,26 @@ int main() {
     // Initialize variables
     init_variables();
     
-    // Initialize readline for better tab completion
-    rl_bind_key('\t', rl_complete);
+    // Initialize readline for better tab completion, and take the
+    // terminal so pipelines can run as foreground/background jobs
+    if (interactive) {
+        rl_bind_key('\t', rl_complete);
+        init_completion();
+        init_history();
+        init_job_control();
+        event_loop = (init_events() == 0);
+    }
 
     while (1) {
-        // Clean up zombie processes before new command
-        cleanup_zombies();
-        update_jobs();
-        
-        // Check for control structures first
-        if (is_control_structure(NULL)) {
-            if_block_t* if_block = parse_if_structure();
-            if (if_block != NULL) {
-                execute_if_block(if_block);
-                
-                // Free if_block memory
-                free(if_block->condition_command);
-                for (int i = 0; i < if_block->then_count; i++) {
-                    if (if_block->then_commands[i] != NULL) {
-                        free(if_block->then_commands[i]);
-                    }
-                }
-                for (int i = 0; i < if_block->else_count; i++) {
-                    if (if_block->else_commands[i] != NULL) {
-                        free(if_block->else_commands[i]);
-                    }
-                }
-                free(if_block);
-                continue;
-            }
+        // Without the event loop, finished background jobs are only
+        // noticed here, before each prompt or script line
+        if (!event_loop) {
+            update_jobs();
         }
         
         // Regular command input
         cmdline = read_cmd(PROMPT);
-        if (cmdline == NULL) break; // Ctrl+D
+        if (cmdline == NULL) break; // Ctrl+D or end of script
         
         // Skip empty commands
         if (strlen(cmdline) == 0) {
@@ -52,7 +58,7 @@ int main() {
         }
         
         // Handle history execution before tokenization
-        if (cmdline[0] == '!') {
+        if (interactive && cmdline[0] == '!') {
             handle_history_execution(&cmdline);
             if (cmdline == NULL) {
                 free(cmdline);
@@ -60,51 +66,29 @@ int main() {
             }
         }
         
-        // Check for variable assignment
-        if (is_variable_assignment(cmdline)) {
-            if (!handle_variable_assignment(cmdline)) {
-                printf("Error: Invalid variable assignment\n");
-            }
-            free(cmdline);
-            continue;
-        }
+        // Here-document bodies follow the line that starts them
+        cmdline = read_here_documents(cmdline);
         
-        // Check for command chaining (semicolon)
-        if (strstr(cmdline, ";") != NULL) {
-            execute_command_chain(cmdline);
-        } else {
-            // Parse the command line (handles pipes and redirection)
-            pipeline = parse_command_line(cmdline);
-            
-            if (pipeline != NULL && pipeline->num_commands > 0) {
-                // Expand variables in the command
-                for (int i = 0; i < pipeline->num_commands; i++) {
-                    expand_variables(&pipeline->commands[i].args);
-                }
-                
-                // Check if it's a built-in command (only for single commands without pipes/redirection)
-                if (pipeline->num_commands == 1 && 
-                    pipeline->commands[0].input_file == NULL && 
-                    pipeline->commands[0].output_file == NULL &&
-                    !pipeline->commands[0].background) {
-                    
-                    char** arglist = pipeline->commands[0].args;
-                    if (!handle_builtin(arglist)) {
-                        execute_pipeline(pipeline);
-                    }
-                } else {
-                    // Execute pipeline or command with redirection/background
-                    execute_pipeline(pipeline);
-                }
-                
-                free_pipeline(pipeline);
-            } else {
-                printf("Error: Failed to parse command\n");
-            }
-        }
+        // Directory listings cached by globs and stat results cached by
+        // tests last only for one line
+        glob_cache_clear();
+        test_cache_clear();
+        
+        // Parse the line (and any lines an open if, loop or here-document
+        // needs) into one tree and run it: pipes, redirection, ; && || and
+        // &, variable assignments, builtins and control structures
+        arena_mark_t mark = arena_mark(&line_arena);
+        char* text;
+        node_t* root = read_program(cmdline, &text);
+        status = last_status = (root != NULL) ? execute_node(root) : 2;
+        arena_release(&line_arena, mark);
+        free(text);
         free(cmdline);
     }
 
-    printf("\nShell exited.\n");
-    return 0;
+    input_close();
+    if (interactive) {
+        printf("\nShell exited.\n");
+    }
+    return status;
 }
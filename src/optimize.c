@@ -0,0 +1,81 @@
+#include "shell.h"
+
+// Pipeline optimizer, run on every pipeline just before it is expanded and
+// launched (see run_pipeline()). Each elided stage saves a process, an
+// exec and a copy of the data through a pipe.
+//
+//   cat FILE | cmd ...   ->  cmd ... < FILE
+//   a | cat | b          ->  a | b
+//
+// A bare cat at either end is kept: dropping it would hand the next stage
+// the shell's stdin, or the previous one its stdout, instead of a pipe,
+// which changes how many programs behave (a terminal above all). A
+// cat feeding a builtin, a compound command or an assignment is kept too,
+// since a one-stage result would run in the shell itself (`cat f | read x`
+// must not set x, nor `cat f | exit` exit). So is cat FILE when FILE cannot
+// be read, so that cat still reports it and the pipeline's status is what
+// it would have been. Turned off with: set +o pipeopt
+
+// True for a cat stage with no options, no redirections and at most one
+// plain file operand (nothing that expansion could turn into more words)
+static int is_simple_cat(command_t* cmd) {
+    if (cmd->argc < 1 || cmd->argc > 2 || strcmp(cmd->args[0], "cat") != 0) return 0;
+    if (cmd->input_file != NULL || cmd->here_text != NULL || cmd->output_file != NULL) return 0;
+    
+    if (cmd->argc == 2) {
+        char* file = cmd->args[1];
+        if (file[0] == '-' || file[0] == '\0') return 0;
+        if (strpbrk(file, "$`*?[{~") != NULL) return 0;
+    }
+    return 1;
+}
+
+// True when cmd is sure to run as an external program, whatever its words
+// expand to
+static int is_external(command_t* cmd) {
+    char* name = cmd->args[0];
+    if (cmd->compound != NULL || name == NULL || is_builtin(name)) return 0;
+    return strpbrk(name, "$`=") == NULL;
+}
+
+// True for a file that `cmd < file` reads the same as cat would
+static int is_readable_file(const char* file) {
+    struct stat st;
+    return access(file, R_OK) == 0 && stat(file, &st) == 0 && !S_ISDIR(st.st_mode);
+}
+
+static void remove_stage(pipeline_t* pipeline, int index) {
+    for (int i = index; i < pipeline->num_commands - 1; i++) {
+        pipeline->commands[i] = pipeline->commands[i + 1];
+    }
+    pipeline->num_commands--;
+}
+
+// Rewrite the pipeline in place; returns the number of stages removed
+int optimize_pipeline(pipeline_t* pipeline) {
+    int elided = 0;
+    
+    for (int i = 0; i < pipeline->num_commands - 1; i++) {
+        command_t* cmd = &pipeline->commands[i];
+        command_t* next = &pipeline->commands[i + 1];
+        if (!is_simple_cat(cmd) || !is_external(next)) continue;
+        
+        if (cmd->argc == 2) {
+            // Only a leading cat FILE can become a redirection, and only
+            // if the next stage does not read from a file already
+            if (i != 0 || next->input_file != NULL || next->here_text != NULL) continue;
+            if (!is_readable_file(cmd->args[1])) continue;
+            next->input_file = cmd->args[1];
+        } else if (i == 0) {
+            continue;
+        }
+        
+        // A bare cat between stages just copies its input
+        remove_stage(pipeline, i);
+        elided++;
+        i--;
+    }
+    
+    shell_stats.stages_elided += elided;
+    return elided;
+}
@@ -0,0 +1,268 @@
+#include "shell.h"
+#include <errno.h>
+#include <poll.h>
+
+// parallel [-j N] command [args...] [::: item...]
+//
+// Runs the command once per item with at most N tasks at a time (default:
+// one per online CPU). Items come after ::: or, without it, one per line
+// from stdin. Every {} in the template is replaced by the item; with no {}
+// the item is appended as the last argument.
+//
+// Each task's stdout goes into its own pipe and is written out in input
+// order: the oldest unfinished task streams straight through, later ones
+// are buffered until it is their turn. The exit status is the number of
+// failed tasks (at most 101), and failed tasks are listed on stderr.
+
+typedef struct {
+    char** args;
+    pid_t pid;
+    int fd;          // read end of the task's stdout pipe, -1 at EOF
+    char* output;    // buffered output while an earlier task is unfinished
+    size_t length;
+    size_t capacity;
+    int status;
+    int done;
+} task_t;
+
+static void write_all(char* data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        length -= n;
+    }
+}
+
+// Split everything on stdin into lines, stored in arena
+static char** read_items(arena_t* arena, int* count) {
+    size_t size;
+    char* data = input_slurp(STDIN_FILENO, &size);
+    
+    int lines = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] == '\n') lines++;
+    }
+    
+    char** items = arena_alloc(arena, (lines + 1) * sizeof(char*));
+    *count = 0;
+    size_t start = 0;
+    for (size_t i = 0; i <= size; i++) {
+        if (i == size || data[i] == '\n') {
+            if (i > start) items[(*count)++] = arena_strndup(arena, data + start, i - start);
+            start = i + 1;
+        }
+    }
+    free(data);
+    return items;
+}
+
+// Replace every {} in word with item
+static char* substitute(arena_t* arena, char* word, char* item) {
+    size_t item_length = strlen(item);
+    size_t length = 0;
+    
+    for (char* p = word; *p != '\0'; p++) {
+        if (p[0] == '{' && p[1] == '}') {
+            length += item_length;
+            p++;
+        } else {
+            length++;
+        }
+    }
+    
+    char* result = arena_alloc(arena, length + 1);
+    char* out = result;
+    for (char* p = word; *p != '\0'; p++) {
+        if (p[0] == '{' && p[1] == '}') {
+            memcpy(out, item, item_length);
+            out += item_length;
+            p++;
+        } else {
+            *out++ = *p;
+        }
+    }
+    *out = '\0';
+    return result;
+}
+
+// Build the argument vector of one task from the template
+static char** task_args(arena_t* arena, char** template, int words, char* item) {
+    int has_placeholder = 0;
+    for (int i = 0; i < words; i++) {
+        if (strstr(template[i], "{}") != NULL) has_placeholder = 1;
+    }
+    
+    char** args = arena_alloc(arena, (words + 2) * sizeof(char*));
+    for (int i = 0; i < words; i++) {
+        args[i] = has_placeholder ? substitute(arena, template[i], item) : template[i];
+    }
+    args[words] = has_placeholder ? NULL : item;
+    args[words + 1] = NULL;
+    return args;
+}
+
+static void start_task(task_t* task, int null_stdin) {
+    int out[2];
+    
+    task->done = 1;
+    task->status = 127;
+    if (pipe2(out, O_CLOEXEC) < 0) {
+        perror("parallel: pipe");
+        return;
+    }
+    
+    task->pid = spawn_external(task->args, null_stdin, out[1], NULL);
+    close(out[1]);
+    if (task->pid < 0) {
+        task->status = -task->pid;
+        close(out[0]);
+        return;
+    }
+    task->fd = out[0];
+    task->done = 0;
+}
+
+// Drain one readable task pipe; the task is reaped once its output ends
+static void read_task(task_t* task, int streaming) {
+    char buffer[65536];
+    ssize_t n = read(task->fd, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR) return;
+    
+    if (n > 0) {
+        if (streaming) {
+            write_all(buffer, n);
+            return;
+        }
+        if (task->length + n > task->capacity) {
+            task->capacity = (task->length + n) * 2;
+            task->output = realloc(task->output, task->capacity);
+        }
+        memcpy(task->output + task->length, buffer, n);
+        task->length += n;
+        return;
+    }
+    
+    close(task->fd);
+    task->fd = -1;
+    
+    int status;
+    while (waitpid(task->pid, &status, 0) < 0 && errno == EINTR);
+    task->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    task->done = 1;
+}
+
+int execute_parallel(char** args) {
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int i = 1;
+    
+    while (args[i] != NULL && args[i][0] == '-' && args[i][1] == 'j') {
+        char* value = args[i][2] != '\0' ? args[i] + 2 : args[++i];
+        if (value == NULL || atol(value) <= 0) {
+            fprintf(stderr, "parallel: -j needs a positive number\n");
+            return 2;
+        }
+        jobs = atol(value);
+        i++;
+    }
+    
+    char** template = &args[i];
+    int words = 0;
+    while (template[words] != NULL && strcmp(template[words], ":::") != 0) words++;
+    if (words == 0) {
+        fprintf(stderr, "usage: parallel [-j N] command [args...] [::: item...]\n");
+        return 2;
+    }
+    
+    arena_t arena;
+    arena_init(&arena);
+    
+    char** items;
+    int count = 0;
+    int from_stdin = template[words] == NULL;
+    if (from_stdin) {
+        items = read_items(&arena, &count);
+    } else {
+        items = &template[words + 1];
+        while (items[count] != NULL) count++;
+    }
+    
+    // Items read from stdin used it up; tasks read /dev/null instead
+    int null_stdin = from_stdin ? open("/dev/null", O_RDONLY | O_CLOEXEC) : -1;
+    
+    task_t* tasks = calloc(count > 0 ? count : 1, sizeof(task_t));
+    for (int t = 0; t < count; t++) {
+        tasks[t].args = task_args(&arena, template, words, items[t]);
+        tasks[t].fd = -1;
+    }
+    
+    struct pollfd* fds = malloc((jobs < count ? jobs : count + 1) * sizeof(struct pollfd));
+    int* owners = malloc((jobs < count ? jobs : count + 1) * sizeof(int));
+    int next_start = 0;
+    int next_print = 0;
+    int running = 0;
+    
+    fflush(stdout);
+    while (next_print < count) {
+        while (running < jobs && next_start < count) {
+            start_task(&tasks[next_start], null_stdin);
+            if (!tasks[next_start].done) running++;
+            next_start++;
+        }
+        
+        // Emit finished tasks in order, then let the new oldest one stream
+        while (next_print < count && tasks[next_print].done) {
+            write_all(tasks[next_print].output, tasks[next_print].length);
+            free(tasks[next_print].output);
+            tasks[next_print].output = NULL;
+            next_print++;
+        }
+        if (next_print == count) break;
+        task_t* head = &tasks[next_print];
+        if (head->length > 0) {
+            write_all(head->output, head->length);
+            head->length = 0;
+        }
+        
+        int num_fds = 0;
+        for (int t = next_print; t < next_start; t++) {
+            if (tasks[t].fd < 0) continue;
+            fds[num_fds].fd = tasks[t].fd;
+            fds[num_fds].events = POLLIN;
+            owners[num_fds++] = t;
+        }
+        if (num_fds == 0) continue;
+        
+        if (poll(fds, num_fds, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("parallel: poll");
+            break;
+        }
+        for (int f = 0; f < num_fds; f++) {
+            if (fds[f].revents == 0) continue;
+            task_t* task = &tasks[owners[f]];
+            read_task(task, owners[f] == next_print);
+            if (task->done) running--;
+        }
+    }
+    
+    int failed = 0;
+    for (int t = 0; t < count; t++) {
+        if (tasks[t].status == 0) continue;
+        if (failed++ == 0) fprintf(stderr, "parallel: failed tasks:\n");
+        fprintf(stderr, "  [%d] exit %d:", t + 1, tasks[t].status);
+        for (int a = 0; tasks[t].args[a] != NULL; a++) fprintf(stderr, " %s", tasks[t].args[a]);
+        fprintf(stderr, "\n");
+    }
+    if (failed > 0) fprintf(stderr, "parallel: %d of %d tasks failed\n", failed, count);
+    
+    if (null_stdin >= 0) close(null_stdin);
+    free(fds);
+    free(owners);
+    free(tasks);
+    arena_free(&arena);
+    return failed > 101 ? 101 : failed;
+}
@@ -2,88 +2,757 @@
 #include <string.h>
 #include <stdlib.h>
 
-pipeline_t* parse_command_line(char* cmdline) {
-    if (cmdline == NULL || strlen(cmdline) == 0) return NULL;
+// Command line parsing.
+//
+// The lexer makes a single pass over the input buffer and never copies:
+// a word token is a span of the buffer, NUL-terminated in place. Quotes
+// and backslashes are only used to find word boundaries here; they stay
+// in the word and are removed during expansion. All pipeline_t/command_t
+// storage comes from an arena, so a whole line is released at once.
+
+// Arena holding parsed command lines
+arena_t line_arena;
+
+void lexer_init(lexer_t* lexer, char* input) {
+    lexer->pos = input;
+    lexer->saved = '\0';
+}
+
+// Current character, including one hidden under a word's terminating NUL
+static char lex_peek(lexer_t* lexer) {
+    return lexer->saved ? lexer->saved : *lexer->pos;
+}
+
+static void lex_advance(lexer_t* lexer, int n) {
+    lexer->saved = '\0';
+    lexer->pos += n;
+}
+
+static int is_operator_char(char c) {
+    return c == '|' || c == '&' || c == ';' || c == '<' || c == '>' || c == '\n';
+}
+
+// Find the ) or } closing the $( or ${ whose ( or { is at p, skipping
+// quotes, escapes and nested brackets. NULL if the input ends first.
+char* skip_substitution(char* p) {
+    char open = *p;
+    char close = (open == '(') ? ')' : '}';
+    int depth = 0;
+    
+    for (; *p != '\0'; p++) {
+        if (*p == '\\') {
+            if (p[1] != '\0') p++;
+        } else if (*p == '\'') {
+            p = strchr(p + 1, '\'');
+            if (p == NULL) return NULL;
+        } else if (*p == '"') {
+            for (p++; *p != '\0' && *p != '"'; p++) {
+                if (*p == '\\' && p[1] != '\0') p++;
+                else if (*p == '$' && (p[1] == '(' || p[1] == '{') && (p = skip_substitution(p + 1)) == NULL) return NULL;
+                else if (*p == '`' && (p = skip_backquote(p)) == NULL) return NULL;
+            }
+            if (*p == '\0') return NULL;
+        } else if (*p == '`') {
+            p = skip_backquote(p);
+            if (p == NULL) return NULL;
+        } else if (*p == open) {
+            depth++;
+        } else if (*p == close && --depth == 0) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// Find the unescaped ` closing the one at p, or NULL
+char* skip_backquote(char* p) {
+    for (p++; *p != '\0'; p++) {
+        if (*p == '\\' && p[1] != '\0') p++;
+        else if (*p == '`') return p;
+    }
+    return NULL;
+}
+
+// Read the next token. Word tokens are terminated in place; when the
+// character after a word is an operator it is remembered in lexer->saved
+// before being overwritten.
+void lex_next(lexer_t* lexer, token_t* token) {
+    char c = lex_peek(lexer);
+    
+    // Skip blanks and comments
+    while (c == ' ' || c == '\t' || c == '#') {
+        if (c == '#') {
+            while (*lexer->pos != '\0' && *lexer->pos != '\n') lex_advance(lexer, 1);
+        } else {
+            lex_advance(lexer, 1);
+        }
+        c = lex_peek(lexer);
+    }
+    
+    token->text = lexer->pos;
+    token->len = 1;
+    
+    switch (c) {
+        case '\0':
+            token->type = TOK_END;
+            token->len = 0;
+            return;
+        case '\n':
+            token->type = TOK_NEWLINE;
+            lex_advance(lexer, 1);
+            return;
+        case ';':
+            token->type = TOK_SEQ;
+            lex_advance(lexer, 1);
+            return;
+        case '<':
+            if (lexer->pos[1] == '<' && lexer->pos[2] == '<') {
+                token->type = TOK_TLESS;
+                token->len = 3;
+            } else if (lexer->pos[1] == '<') {
+                token->type = lexer->pos[2] == '-' ? TOK_DLESSDASH : TOK_DLESS;
+                token->len = lexer->pos[2] == '-' ? 3 : 2;
+            } else {
+                token->type = TOK_LESS;
+            }
+            lex_advance(lexer, token->len);
+            return;
+        case '|':
+        case '&':
+        case '>':
+            if (lexer->pos[1] == c) {
+                token->type = (c == '|') ? TOK_OR : (c == '&') ? TOK_AND : TOK_DGREAT;
+                token->len = 2;
+                lex_advance(lexer, 2);
+            } else {
+                token->type = (c == '|') ? TOK_PIPE : (c == '&') ? TOK_BG : TOK_GREAT;
+                lex_advance(lexer, 1);
+            }
+            return;
+    }
+    
+    // Word: runs until an unquoted blank or operator
+    char* p = lexer->pos;
+    while (*p != '\0' && *p != ' ' && *p != '\t' && !is_operator_char(*p)) {
+        if (*p == '\\') {
+            if (p[1] != '\0') p++;
+        } else if (*p == '\'') {
+            char* close = strchr(p + 1, '\'');
+            if (close == NULL) {
+                token->type = TOK_ERROR;
+                return;
+            }
+            p = close;
+        } else if (*p == '"') {
+            p++;
+            while (*p != '\0' && *p != '"') {
+                if (*p == '\\' && p[1] != '\0') {
+                    p++;
+                } else if ((*p == '$' && (p[1] == '(' || p[1] == '{') && (p = skip_substitution(p + 1)) == NULL) ||
+                           (*p == '`' && (p = skip_backquote(p)) == NULL)) {
+                    token->type = TOK_ERROR;
+                    return;
+                }
+                p++;
+            }
+            if (*p == '\0') {
+                token->type = TOK_ERROR;
+                return;
+            }
+        } else if ((*p == '$' && (p[1] == '(' || p[1] == '{')) || *p == '`') {
+            // A substitution or ${...} is part of the word, operators and all
+            char* close = (*p == '`') ? skip_backquote(p) : skip_substitution(p + 1);
+            if (close == NULL) {
+                token->type = TOK_ERROR;
+                return;
+            }
+            p = close;
+        }
+        p++;
+    }
+    
+    token->type = TOK_WORD;
+    token->len = p - lexer->pos;
+    
+    lexer->saved = '\0';
+    if (*p == ' ' || *p == '\t') {
+        *p = '\0';
+        lexer->pos = p + 1;
+    } else {
+        lexer->saved = *p; // operator or the end of input
+        *p = '\0';
+        lexer->pos = p;
+    }
+}
+
+// Remove quotes and backslashes from a here-document delimiter, in place
+char* here_delimiter(char* word) {
+    char* out = word;
+    char quote = '\0';
     
-    pipeline_t* pipeline = malloc(sizeof(pipeline_t));
-    pipeline->num_commands = 0;
-    pipeline->background = 0;
+    for (char* p = word; *p != '\0'; p++) {
+        if (quote != '\0' && *p == quote) {
+            quote = '\0';
+        } else if (quote == '\0' && (*p == '\'' || *p == '"')) {
+            quote = *p;
+        } else {
+            if (*p == '\\' && quote != '\'' && p[1] != '\0') p++;
+            *out++ = *p;
+        }
+    }
+    *out = '\0';
+    return word;
+}
+
+// A << or <<- redirection whose body starts after the next newline
+typedef struct {
+    pipeline_t* pipeline;
+    int index;          // command within the pipeline
+    char* delimiter;
+    int strip_tabs;     // <<-
+} pending_here_t;
+
+// Parser state: the lexer plus one token of lookahead
+typedef struct {
+    lexer_t lexer;
+    token_t token;
+    arena_t* arena;
+    int error;      // a syntax error was found
+    int incomplete; // input ended inside an unfinished construct
+    pending_here_t* pending;
+    int num_pending;
+    int pending_capacity;
+} parser_t;
+
+// Take the bodies of the pending here-documents from the lines after the
+// newline just read, and continue lexing after the last delimiter. Like
+// words, bodies are terminated in place; <<- strips leading tabs by moving
+// each line down over them.
+static void read_here_bodies(parser_t* ps) {
+    char* pos = ps->lexer.pos;
+    
+    for (int i = 0; i < ps->num_pending; i++) {
+        pending_here_t* here = &ps->pending[i];
+        size_t delimiter_length = strlen(here->delimiter);
+        char* body = pos;
+        char* out = pos;
+        
+        while (1) {
+            if (*pos == '\0') {
+                // More lines may still bring the delimiter
+                ps->error = 1;
+                ps->incomplete = 1;
+                ps->num_pending = 0;
+                ps->lexer.pos = pos;
+                return;
+            }
+            
+            char* line = pos;
+            if (here->strip_tabs) {
+                while (*line == '\t') line++;
+            }
+            char* end = strchr(line, '\n');
+            if (end == NULL) end = line + strlen(line);
+            
+            if ((size_t)(end - line) == delimiter_length && strncmp(line, here->delimiter, delimiter_length) == 0) {
+                pos = (*end == '\n') ? end + 1 : end;
+                break;
+            }
+            size_t n = (*end == '\n') ? end + 1 - line : end - line;
+            memmove(out, line, n);
+            out += n;
+            pos = line + n;
+        }
+        *out = '\0';
+        
+        command_t* cmd = &here->pipeline->commands[here->index];
+        if (cmd->here_kind == HERE_DOC || cmd->here_kind == HERE_DOC_QUOTED) cmd->here_text = body;
+    }
+    ps->num_pending = 0;
+    ps->lexer.pos = pos;
+}
+
+static void advance(parser_t* ps) {
+    lex_next(&ps->lexer, &ps->token);
+    
+    if (ps->num_pending > 0) {
+        if (ps->token.type == TOK_NEWLINE) {
+            read_here_bodies(ps);
+        } else if (ps->token.type == TOK_END) {
+            ps->error = 1;
+            ps->incomplete = 1;
+        }
+    }
+}
+
+// Grow an arena array by doubling; the old copy is simply abandoned
+static void* grow_array(arena_t* arena, void* old, int count, int* capacity, size_t elem_size) {
+    int new_capacity = *capacity ? *capacity * 2 : 8;
+    void* array = arena_alloc(arena, new_capacity * elem_size);
+    if (old != NULL) memcpy(array, old, count * elem_size);
+    *capacity = new_capacity;
+    return array;
+}
+
+// Report a syntax error at the current token. Running out of input is
+// only noted, since more lines may complete the construct.
+static void syntax_error(parser_t* ps) {
+    static const char* operator_names[] = {"", "|", "&&", "||", ";", "&", "<", ">", ">>", "<<", "<<-", "<<<",
+                                           "newline"};
+    token_t* token = &ps->token;
+    
+    ps->error = 1;
+    if (token->type == TOK_END) {
+        ps->incomplete = 1;
+    } else if (token->type == TOK_ERROR) {
+        fprintf(stderr, "myshell: syntax error: unterminated quote or substitution\n");
+    } else if (token->type == TOK_WORD) {
+        fprintf(stderr, "myshell: syntax error near '%s'\n", token->text);
+    } else {
+        fprintf(stderr, "myshell: syntax error near '%s'\n", operator_names[token->type]);
+    }
+}
+
+static int is_keyword(token_t* token, const char* keyword) {
+    return token->type == TOK_WORD && strcmp(token->text, keyword) == 0;
+}
+
+// Keywords that close a list when they appear where a command would start
+static int at_list_end(parser_t* ps) {
+    token_t* token = &ps->token;
+    return token->type == TOK_END || is_keyword(token, "then") || is_keyword(token, "elif") ||
+           is_keyword(token, "else") || is_keyword(token, "fi") || is_keyword(token, "do") ||
+           is_keyword(token, "done");
+}
+
+static void skip_newlines(parser_t* ps) {
+    while (ps->token.type == TOK_NEWLINE) advance(ps);
+}
+
+static int is_compound_start(token_t* token) {
+    return is_keyword(token, "if") || is_keyword(token, "while") || is_keyword(token, "until") ||
+           is_keyword(token, "for");
+}
+
+static node_t* parse_compound(parser_t* ps);
+
+// The words of [[ ... ]] into cmd, with the current token on [[. Inside
+// the brackets && || < and > are operands of the test, not operators of
+// the shell, so they become words too; newlines may separate words.
+static int parse_conditional(parser_t* ps, command_t* cmd) {
+    static const char* operators[] = {[TOK_AND] = "&&", [TOK_OR] = "||", [TOK_LESS] = "<", [TOK_GREAT] = ">"};
+    int arg_capacity = 0;
     
-    // Check for background execution
-    char* bg_ptr = strchr(cmdline, '&');
-    if (bg_ptr != NULL) {
-        pipeline->background = 1;
-        *bg_ptr = '\0'; // Remove & from command string
+    cmd->conditional = 1;
+    while (1) {
+        token_t* token = &ps->token;
+        int closing = 0;
+        char* word;
+        if (token->type == TOK_WORD) {
+            word = token->text;
+            closing = strcmp(word, "]]") == 0;
+        } else if (token->type == TOK_AND || token->type == TOK_OR || token->type == TOK_LESS ||
+                   token->type == TOK_GREAT) {
+            word = arena_strdup(ps->arena, operators[token->type]);
+        } else if (token->type == TOK_NEWLINE) {
+            advance(ps);
+            continue;
+        } else {
+            syntax_error(ps);
+            return 0;
+        }
+        
+        if (cmd->argc + 1 >= arg_capacity) {
+            cmd->args = grow_array(ps->arena, cmd->args, cmd->argc, &arg_capacity, sizeof(char*));
+        }
+        cmd->args[cmd->argc++] = word;
+        advance(ps);
+        if (closing) return 1;
     }
+}
+
+// Commands separated by |, each with its words and redirections. A stage
+// may also be a compound command (if, while, until, for) or a [[ ... ]]
+// test, followed only by redirections.
+static pipeline_t* parse_pipeline(parser_t* ps) {
+    arena_t* arena = ps->arena;
+    pipeline_t* pipeline = arena_alloc(arena, sizeof(pipeline_t));
+    memset(pipeline, 0, sizeof(pipeline_t));
+    int command_capacity = 0;
     
-    char* saveptr;
-    char* token = strtok_r(cmdline, "|", &saveptr);
+    // time reports on the whole pipeline it prefixes
+    if (is_keyword(&ps->token, "time")) {
+        pipeline->timed = 1;
+        advance(ps);
+    }
     
-    while (token != NULL && pipeline->num_commands < MAX_COMMANDS) {
-        command_t* current_cmd = &pipeline->commands[pipeline->num_commands];
-        current_cmd->argc = 0;
-        current_cmd->input_file = NULL;
-        current_cmd->output_file = NULL;
-        current_cmd->append_output = 0;
+    while (1) {
+        if (pipeline->num_commands == command_capacity) {
+            pipeline->commands = grow_array(arena, pipeline->commands, pipeline->num_commands,
+                                            &command_capacity, sizeof(command_t));
+        }
+        command_t* cmd = &pipeline->commands[pipeline->num_commands];
+        memset(cmd, 0, sizeof(command_t));
+        int arg_capacity = 0;
+        int output_capacity = 0;
+        int has_redirection = 0;
         
-        // Parse individual command with redirection
-        char* cmd_saveptr;
-        char* cmd_token = strtok_r(token, " \t", &cmd_saveptr);
-        int parsing_args = 1;
+        if (is_compound_start(&ps->token)) {
+            cmd->compound = parse_compound(ps);
+            if (cmd->compound == NULL) return NULL;
+        } else if (is_keyword(&ps->token, "[[")) {
+            if (!parse_conditional(ps, cmd)) return NULL;
+        }
         
-        while (cmd_token != NULL && current_cmd->argc < MAX_ARGS_PER_CMD - 1) {
-            if (strcmp(cmd_token, "<") == 0) {
-                // Input redirection
-                parsing_args = 0;
-                cmd_token = strtok_r(NULL, " \t", &cmd_saveptr);
-                if (cmd_token != NULL) {
-                    current_cmd->input_file = strdup(cmd_token);
+        while (1) {
+            token_t* token = &ps->token;
+            if (token->type == TOK_WORD && (cmd->compound != NULL || cmd->conditional)) {
+                // Nothing but redirections may follow fi, done or ]]
+                syntax_error(ps);
+                return NULL;
+            } else if (token->type == TOK_WORD) {
+                if (cmd->argc + 1 >= arg_capacity) {
+                    cmd->args = grow_array(arena, cmd->args, cmd->argc, &arg_capacity, sizeof(char*));
+                }
+                cmd->args[cmd->argc++] = token->text;
+            } else if (token->type == TOK_LESS || token->type == TOK_GREAT || token->type == TOK_DGREAT) {
+                token_type_t op = token->type;
+                advance(ps);
+                if (token->type != TOK_WORD) {
+                    syntax_error(ps);
+                    return NULL;
+                }
+                if (op == TOK_LESS) {
+                    cmd->input_file = token->text;
+                    cmd->here_text = NULL;
+                    cmd->here_kind = HERE_NONE;
+                } else if (cmd->output_file != NULL) {
+                    // Every further target gets its own copy of the output
+                    if (cmd->num_extra_outputs == output_capacity) {
+                        cmd->extra_outputs = grow_array(arena, cmd->extra_outputs, cmd->num_extra_outputs,
+                                                        &output_capacity, sizeof(output_target_t));
+                    }
+                    output_target_t* target = &cmd->extra_outputs[cmd->num_extra_outputs++];
+                    target->file = token->text;
+                    target->append = (op == TOK_DGREAT);
+                } else {
+                    cmd->output_file = token->text;
+                    cmd->append_output = (op == TOK_DGREAT);
                 }
-            } else if (strcmp(cmd_token, ">") == 0) {
-                // Output redirection (truncate)
-                parsing_args = 0;
-                cmd_token = strtok_r(NULL, " \t", &cmd_saveptr);
-                if (cmd_token != NULL) {
-                    current_cmd->output_file = strdup(cmd_token);
-                    current_cmd->append_output = 0;
+                has_redirection = 1;
+            } else if (token->type == TOK_DLESS || token->type == TOK_DLESSDASH || token->type == TOK_TLESS) {
+                token_type_t op = token->type;
+                advance(ps);
+                if (token->type != TOK_WORD) {
+                    syntax_error(ps);
+                    return NULL;
                 }
-            } else if (strcmp(cmd_token, ">>") == 0) {
-                // Output redirection (append)
-                parsing_args = 0;
-                cmd_token = strtok_r(NULL, " \t", &cmd_saveptr);
-                if (cmd_token != NULL) {
-                    current_cmd->output_file = strdup(cmd_token);
-                    current_cmd->append_output = 1;
+                cmd->input_file = NULL;
+                cmd->here_text = token->text;
+                if (op == TOK_TLESS) {
+                    cmd->here_kind = HERE_STRING;
+                } else {
+                    // The body is filled in once the line's newline is read;
+                    // a quoted delimiter turns off expansion in it
+                    cmd->here_kind = strpbrk(token->text, "'\"\\") ? HERE_DOC_QUOTED : HERE_DOC;
+                    if (ps->num_pending == ps->pending_capacity) {
+                        ps->pending = grow_array(arena, ps->pending, ps->num_pending, &ps->pending_capacity,
+                                                 sizeof(pending_here_t));
+                    }
+                    pending_here_t* here = &ps->pending[ps->num_pending++];
+                    here->pipeline = pipeline;
+                    here->index = pipeline->num_commands;
+                    here->delimiter = here_delimiter(arena_strdup(arena, token->text));
+                    here->strip_tabs = (op == TOK_DLESSDASH);
                 }
-            } else if (parsing_args) {
-                // Regular argument
-                current_cmd->args[current_cmd->argc++] = strdup(cmd_token);
+                has_redirection = 1;
+            } else {
+                break;
             }
-            
-            cmd_token = strtok_r(NULL, " \t", &cmd_saveptr);
+            advance(ps);
         }
         
-        current_cmd->args[current_cmd->argc] = NULL;
+        if (ps->token.type == TOK_ERROR || (cmd->argc == 0 && !has_redirection && cmd->compound == NULL)) {
+            syntax_error(ps);
+            return NULL;
+        }
+        if (cmd->args == NULL) {
+            cmd->args = grow_array(arena, NULL, 0, &arg_capacity, sizeof(char*));
+        }
+        cmd->args[cmd->argc] = NULL;
         pipeline->num_commands++;
-        token = strtok_r(NULL, "|", &saveptr);
+        
+        if (ps->token.type != TOK_PIPE) break;
+        advance(ps);
+        skip_newlines(ps);
     }
-    
     return pipeline;
 }
 
-void free_pipeline(pipeline_t* pipeline) {
-    if (pipeline == NULL) return;
-    
+static void set_background(pipeline_t* pipeline) {
+    pipeline->background = 1;
     for (int i = 0; i < pipeline->num_commands; i++) {
-        command_t* cmd = &pipeline->commands[i];
+        pipeline->commands[i].background = 1;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Syntax tree for command lines, scripts and control structures
+//
+//   list     := and_or ((';' | '&' | newline) and_or)*
+//   and_or   := command (('&&' | '||') command)*
+//   command  := pipeline
+//   pipeline := ['time'] stage ('|' stage)*
+//   stage    := (word | redirection)+ | compound redirection* | '[[' word* ']]' redirection*
+//   compound := if_clause | while_clause | for_clause
+//   if_clause:= 'if' list 'then' list ('elif' list 'then' list)* ['else' list] 'fi'
+//   while_clause := ('while' | 'until') list 'do' list 'done'
+//   for_clause   := 'for' name ['in' word*] (';' | newline) 'do' list 'done'
+//
+// The tree is built once; execute_node() walks it without re-tokenizing,
+// however many times a loop runs it.
+// ---------------------------------------------------------------------------
+
+static node_t* new_node(parser_t* ps, node_type_t type) {
+    node_t* node = arena_alloc(ps->arena, sizeof(node_t));
+    memset(node, 0, sizeof(node_t));
+    node->type = type;
+    return node;
+}
+
+static node_t* parse_list(parser_t* ps);
+
+// Expect the keyword at the current token and step past it
+static int expect_keyword(parser_t* ps, const char* keyword) {
+    if (!is_keyword(&ps->token, keyword)) {
+        syntax_error(ps);
+        return 0;
+    }
+    advance(ps);
+    return 1;
+}
+
+// A list that must hold at least one command (if conditions and bodies)
+static node_t* parse_required_list(parser_t* ps) {
+    node_t* list = parse_list(ps);
+    if (list != NULL && list->body == NULL) {
+        syntax_error(ps);
+        return NULL;
+    }
+    return list;
+}
+
+// if/elif chain; called with the current token on 'if' or 'elif'
+static node_t* parse_if(parser_t* ps) {
+    node_t* node = new_node(ps, NODE_IF);
+    advance(ps);
+    
+    node->cond = parse_required_list(ps);
+    if (node->cond == NULL || !expect_keyword(ps, "then")) return NULL;
+    
+    node->body = parse_required_list(ps);
+    if (node->body == NULL) return NULL;
+    
+    if (is_keyword(&ps->token, "elif")) {
+        // elif is an if nested in the else branch that shares our fi
+        node->other = parse_if(ps);
+        return node->other != NULL ? node : NULL;
+    }
+    
+    if (is_keyword(&ps->token, "else")) {
+        advance(ps);
+        node->other = parse_required_list(ps);
+        if (node->other == NULL) return NULL;
+    }
+    
+    if (!expect_keyword(ps, "fi")) return NULL;
+    return node;
+}
+
+// 'do' list 'done', the body shared by every loop
+static node_t* parse_do_group(parser_t* ps) {
+    skip_newlines(ps);
+    if (!expect_keyword(ps, "do")) return NULL;
+    
+    node_t* body = parse_required_list(ps);
+    if (body == NULL || !expect_keyword(ps, "done")) return NULL;
+    return body;
+}
+
+// while/until; called with the current token on the keyword
+static node_t* parse_while(parser_t* ps) {
+    node_t* node = new_node(ps, is_keyword(&ps->token, "until") ? NODE_UNTIL : NODE_WHILE);
+    advance(ps);
+    
+    node->cond = parse_required_list(ps);
+    if (node->cond == NULL) return NULL;
+    node->body = parse_do_group(ps);
+    return node->body != NULL ? node : NULL;
+}
+
+// for NAME [in WORD...]; the words are kept as written and expanded each
+// time the loop starts
+static node_t* parse_for(parser_t* ps) {
+    node_t* node = new_node(ps, NODE_FOR);
+    advance(ps);
+    
+    if (ps->token.type != TOK_WORD || !is_name(ps->token.text)) {
+        syntax_error(ps);
+        return NULL;
+    }
+    node->name = ps->token.text;
+    advance(ps);
+    skip_newlines(ps);
+    
+    int count = 0, capacity = 0;
+    if (is_keyword(&ps->token, "in")) {
+        advance(ps);
+        while (ps->token.type == TOK_WORD) {
+            if (count + 1 >= capacity) {
+                node->words = grow_array(ps->arena, node->words, count, &capacity, sizeof(char*));
+            }
+            node->words[count++] = ps->token.text;
+            advance(ps);
+        }
+        if (ps->token.type != TOK_SEQ && ps->token.type != TOK_NEWLINE) {
+            syntax_error(ps);
+            return NULL;
+        }
+        advance(ps);
+    } else if (ps->token.type == TOK_SEQ) {
+        advance(ps);
+    }
+    if (node->words == NULL) node->words = arena_alloc(ps->arena, sizeof(char*));
+    node->words[count] = NULL;
+    
+    node->body = parse_do_group(ps);
+    return node->body != NULL ? node : NULL;
+}
+
+// Called with the current token on if, while, until or for
+static node_t* parse_compound(parser_t* ps) {
+    if (is_keyword(&ps->token, "if")) {
+        return parse_if(ps);
+    }
+    if (is_keyword(&ps->token, "for")) {
+        return parse_for(ps);
+    }
+    return parse_while(ps);
+}
+
+static int has_redirection(command_t* cmd) {
+    return cmd->input_file != NULL || cmd->output_file != NULL || cmd->here_kind != HERE_NONE;
+}
+
+// A compound command standing alone is returned as its own node, so the
+// shell runs it directly; anything else becomes a NODE_PIPELINE
+static node_t* parse_command(parser_t* ps) {
+    pipeline_t* pipeline = parse_pipeline(ps);
+    if (pipeline == NULL) return NULL;
+    
+    command_t* cmd = &pipeline->commands[0];
+    if (pipeline->num_commands == 1 && cmd->compound != NULL && !pipeline->timed && !has_redirection(cmd)) {
+        return cmd->compound;
+    }
+    
+    node_t* node = new_node(ps, NODE_PIPELINE);
+    node->pipeline = pipeline;
+    return node;
+}
+
+// Wrap a bare compound command in a one-stage pipeline, for &
+static node_t* compound_pipeline(parser_t* ps, node_t* compound) {
+    pipeline_t* pipeline = arena_alloc(ps->arena, sizeof(pipeline_t));
+    memset(pipeline, 0, sizeof(pipeline_t));
+    pipeline->num_commands = 1;
+    pipeline->commands = arena_alloc(ps->arena, sizeof(command_t));
+    memset(pipeline->commands, 0, sizeof(command_t));
+    pipeline->commands[0].args = arena_alloc(ps->arena, sizeof(char*));
+    pipeline->commands[0].args[0] = NULL;
+    pipeline->commands[0].compound = compound;
+    
+    node_t* node = new_node(ps, NODE_PIPELINE);
+    node->pipeline = pipeline;
+    return node;
+}
+
+static node_t* parse_and_or(parser_t* ps) {
+    node_t* left = parse_command(ps);
+    
+    while (left != NULL && (ps->token.type == TOK_AND || ps->token.type == TOK_OR)) {
+        node_t* node = new_node(ps, ps->token.type == TOK_AND ? NODE_AND : NODE_OR);
+        advance(ps);
+        skip_newlines(ps);
+        
+        node->cond = left;
+        node->other = parse_command(ps);
+        if (node->other == NULL) return NULL;
+        left = node;
+    }
+    return left;
+}
+
+// Commands up to the end of input or a closing keyword
+static node_t* parse_list(parser_t* ps) {
+    node_t* list = new_node(ps, NODE_LIST);
+    node_t* last = NULL;
+    
+    while (1) {
+        while (ps->token.type == TOK_NEWLINE || ps->token.type == TOK_SEQ) advance(ps);
+        if (at_list_end(ps)) break;
+        
+        node_t* child = parse_and_or(ps);
+        if (child == NULL) return NULL;
+        
+        if (ps->token.type == TOK_BG) {
+            // & backgrounds the pipeline it follows; a compound command
+            // becomes a pipeline of its own to run as a job
+            node_t** target = &child;
+            while ((*target)->type == NODE_AND || (*target)->type == NODE_OR) target = &(*target)->other;
+            if ((*target)->type != NODE_PIPELINE) *target = compound_pipeline(ps, *target);
+            set_background((*target)->pipeline);
+        }
         
-        for (int j = 0; j < cmd->argc; j++) {
-            free(cmd->args[j]);
+        if (last == NULL) {
+            list->body = child;
+        } else {
+            last->next = child;
         }
+        last = child;
         
-        if (cmd->input_file) free(cmd->input_file);
-        if (cmd->output_file) free(cmd->output_file);
+        if (ps->token.type == TOK_BG) {
+            advance(ps);
+        } else if (ps->token.type == TOK_SEQ || ps->token.type == TOK_NEWLINE) {
+            advance(ps);
+        } else if (!at_list_end(ps)) {
+            syntax_error(ps);
+            return NULL;
+        }
+    }
+    return list;
+}
+
+// Build the syntax tree for text (one or more lines) in arena. Words point
+// into text, which must outlive the tree. Returns NULL on error; if the
+// text simply stops inside a construct, *incomplete is set instead of
+// printing an error so the caller can read more lines.
+node_t* parse_program(arena_t* arena, char* text, int* incomplete) {
+    long long start = stats_clock();
+    parser_t ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.arena = arena;
+    lexer_init(&ps.lexer, text);
+    advance(&ps);
+    
+    node_t* root = parse_list(&ps);
+    if (root != NULL && ps.token.type != TOK_END) {
+        // A closing keyword with nothing open
+        syntax_error(&ps);
+        root = NULL;
     }
     
-    free(pipeline);
+    if (incomplete != NULL) *incomplete = ps.incomplete;
+    shell_stats.parse_ns += stats_clock() - start;
+    shell_stats.parse_calls++;
+    return ps.error ? NULL : root;
 }
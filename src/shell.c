@@ -1,60 +1,231 @@
-// In the handle_builtin function, add set command:
+#include "shell.h"
+
+// Exit status of the last builtin run by handle_builtin()
+int builtin_status = 0;
+
+// Options toggled with set -o / set +o
+shell_options_t shell_options = {1};
+
+// Option names as given to set -o, with the flag each one controls
+static struct {
+    char* name;
+    int* flag;
+} option_table[] = {
+    {"pipeopt", &shell_options.pipeopt},
+    {NULL, NULL}
+};
+
+// exit [n]. Only the interactive shell itself says goodbye; a script, a
+// pipeline stage or a substitution must not get the message in its output.
+static int run_exit(char** args) {
+    if (input_is_interactive() && getpid() == shell_pid) printf("Shell exited.\n");
+    exit(args[1] != NULL ? atoi(args[1]) : 0);
+}
+
+// Builtins that report failure through builtin_status themselves
+static int run_cd(char** args) { execute_cd(args); return builtin_status; }
+static int run_help(char** args) { (void)args; execute_help(); return builtin_status; }
+static int run_jobs(char** args) { (void)args; execute_jobs(); return builtin_status; }
+static int run_history(char** args) { execute_history(args); return builtin_status; }
+static int run_set(char** args) { execute_set(args); return builtin_status; }
+static int run_hash(char** args) { execute_hash(args); return builtin_status; }
+static int run_export(char** args) { execute_export(args); return builtin_status; }
+static int run_unset(char** args) { execute_unset(args); return builtin_status; }
+static int run_stats(char** args) { execute_stats(args); return builtin_status; }
+
+// Every builtin, by name
+builtin_t builtins[] = {
+    {"exit", run_exit}, {"cd", run_cd}, {"help", run_help}, {"jobs", run_jobs},
+    {"history", run_history}, {"set", run_set}, {"hash", run_hash},
+    {"export", run_export}, {"unset", run_unset}, {"stats", run_stats},
+    {"test", execute_test}, {"[", execute_test}, {"[[", execute_conditional},
+    {"fg", execute_fg}, {"bg", execute_bg}, {"wait", execute_wait}, {"kill", execute_kill},
+    {"parallel", execute_parallel}, {"xargs", execute_xargs},
+    {"echo", execute_echo}, {"printf", execute_printf}, {"pwd", execute_pwd},
+    {"true", execute_true}, {"false", execute_false}, {":", execute_true},
+    {"read", execute_read}, {"break", execute_break}, {"continue", execute_continue},
+    {NULL, NULL}
+};
+
+// Open addressing over builtins[], filled on the first lookup. Every
+// command name is looked up, so this replaces a strcmp per builtin with a
+// hash and usually one comparison.
+#define BUILTIN_SLOTS 64
+
+static builtin_t* builtin_slots[BUILTIN_SLOTS];
+
+static unsigned int hash_name(const char* s) {
+    unsigned int h = 2166136261u; // FNV-1a
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static builtin_t* find_builtin(const char* name) {
+    static int filled = 0;
+    
+    if (!filled) {
+        for (builtin_t* b = builtins; b->name != NULL; b++) {
+            unsigned int i = hash_name(b->name) & (BUILTIN_SLOTS - 1);
+            while (builtin_slots[i] != NULL) i = (i + 1) & (BUILTIN_SLOTS - 1);
+            builtin_slots[i] = b;
+        }
+        filled = 1;
+    }
+    
+    unsigned int i = hash_name(name) & (BUILTIN_SLOTS - 1);
+    while (builtin_slots[i] != NULL) {
+        if (strcmp(builtin_slots[i]->name, name) == 0) return builtin_slots[i];
+        i = (i + 1) & (BUILTIN_SLOTS - 1);
+    }
+    return NULL;
+}
+
+// Check whether a command name is a builtin
+int is_builtin(char* name) {
+    return name != NULL && find_builtin(name) != NULL;
+}
+
+// Run arglist if it names a builtin, leaving its exit status in
+// builtin_status. Returns whether it did.
 int handle_builtin(char** arglist) {
     if (arglist[0] == NULL) return 0;
     
-    if (strcmp(arglist[0], "exit") == 0) {
-        printf("Shell exited.\n");
-        exit(0);
-    } else if (strcmp(arglist[0], "cd") == 0) {
-        execute_cd(arglist);
-        return 1;
-    } else if (strcmp(arglist[0], "help") == 0) {
-        execute_help();
-        return 1;
-    } else if (strcmp(arglist[0], "jobs") == 0) {
-        execute_jobs();
-        return 1;
-    } else if (strcmp(arglist[0], "history") == 0) {
-        execute_history();
-        return 1;
-    } else if (strcmp(arglist[0], "set") == 0) {
-        execute_set();
-        return 1;
-    }
-    return 0;
-}
-
-// Add the set command implementation
-void execute_set() {
-    print_variables();
+    builtin_t* builtin = find_builtin(arglist[0]);
+    if (builtin == NULL) return 0;
+    
+    builtin_status = 0;
+    builtin_status = builtin->run(arglist);
+    return 1;
+}
+
+// set: show variables; set -o lists options, set -o/+o NAME turns one on/off
+void execute_set(char** args) {
+    if (args[1] == NULL) {
+        print_variables();
+        return;
+    }
+    
+    if (strcmp(args[1], "-o") != 0 && strcmp(args[1], "+o") != 0) {
+        printf("set: usage: set [-o|+o [option]]\n");
+        builtin_status = 2;
+        return;
+    }
+    
+    int value = (args[1][0] == '-');
+    for (int i = 0; option_table[i].name != NULL; i++) {
+        if (args[2] == NULL) {
+            printf("%-12s %s\n", option_table[i].name, *option_table[i].flag ? "on" : "off");
+        } else if (strcmp(args[2], option_table[i].name) == 0) {
+            *option_table[i].flag = value;
+            return;
+        }
+    }
+    
+    if (args[2] != NULL) {
+        printf("set: %s: invalid option name\n", args[2]);
+        builtin_status = 2;
+    }
+}
+
+// export: list exported variables, or export NAME or NAME=value
+void execute_export(char** args) {
+    if (args[1] == NULL) {
+        for (int i = 0; i < variable_count; i++) {
+            variable_t* var = &variable_list[i];
+            if (!var->exported) continue;
+            if (var->value != NULL) printf("export %s=\"%s\"\n", var->name, var->value);
+            else printf("export %s\n", var->name);
+        }
+        return;
+    }
+    
+    for (int i = 1; args[i] != NULL; i++) {
+        char* equals = strchr(args[i], '=');
+        if (equals != NULL) *equals = '\0';
+        if (export_variable(args[i], equals != NULL ? equals + 1 : NULL) != 0) {
+            printf("export: %s: not a valid identifier\n", args[i]);
+            builtin_status = 1;
+        }
+        if (equals != NULL) *equals = '=';
+    }
+}
+
+// unset: remove variables, and from the environment if they were exported
+void execute_unset(char** args) {
+    for (int i = 1; args[i] != NULL; i++) {
+        if (unset_variable(args[i]) != 0) {
+            printf("unset: %s: not a valid identifier\n", args[i]);
+            builtin_status = 1;
+        }
+    }
+}
+
+// hash: list cached command locations, -r clears, names are looked up now
+void execute_hash(char** args) {
+    if (args[1] == NULL) {
+        print_command_hash();
+        return;
+    }
+    
+    for (int i = 1; args[i] != NULL; i++) {
+        if (strcmp(args[i], "-r") == 0) {
+            clear_command_hash();
+        } else if (hash_command(args[i]) != 0) {
+            printf("hash: %s: not found\n", args[i]);
+        }
+    }
 }
 
 // Update the help command
 void execute_help() {
     printf("Built-in commands:\n");
-    printf("  cd <directory>    - Change current directory\n");
-    printf("  exit              - Exit the shell\n");
+    printf("  cd [dir|-]        - Change current directory (default $HOME, - for the previous one)\n");
+    printf("  pwd               - Print the current directory\n");
+    printf("  echo [-neE] args  - Print arguments\n");
+    printf("  printf fmt args   - Print arguments by a format (%%s %%b %%c %%d %%x %%f ...)\n");
+    printf("  read [-r] [-p p] names - Read a line and split it into variables (default REPLY)\n");
+    printf("  true, false, :    - Do nothing, successfully or not\n");
+    printf("  exit [n]          - Exit the shell\n");
+    printf("  break [n], continue [n] - Leave, or start the next iteration of, the nth enclosing loop\n");
     printf("  help              - Show this help message\n");
-    printf("  jobs              - Show background jobs\n");
-    printf("  history           - Show command history\n");
+    printf("  jobs              - Show background and stopped jobs\n");
+    printf("  fg [%%n]           - Continue a job in the foreground\n");
+    printf("  bg [%%n]           - Continue a stopped job in the background\n");
+    printf("  wait [%%n|pid]     - Wait for jobs to finish\n");
+    printf("  kill [-SIG] %%n|pid - Send a signal to a job or process\n");
+    printf("  history [n]       - Show the last n (default 20) commands of the saved history\n");
     printf("  set               - Show all shell variables\n");
-    printf("  !<number>         - Execute command from history\n");
+    printf("  set -o|+o [name]  - List options or turn one on/off (pipeopt)\n");
+    printf("  hash [-r] [name]  - Show, clear or add cached command locations\n");
+    printf("  export [name[=v]] - Pass variables to started commands, or list them\n");
+    printf("  unset name...     - Remove variables\n");
+    printf("  test, [ ], [[ ]]  - Evaluate file, string and integer conditions\n");
+    printf("  parallel [-j N] cmd [::: items] - Run cmd once per item ({} = item), output in input order\n");
+    printf("  xargs [-0] [-r] [-n N] [-P N] [-g pat] cmd - Run cmd on items from stdin or globs, in ARG_MAX-sized batches\n");
+    printf("  stats [-r]        - Show (or reset) fork/exec/parse/wait counters\n");
+    printf("  time <pipeline>   - Report real, user, sys time and max RSS\n");
+    printf("  !n, !-n, !!, !str - Execute a command from history\n");
     printf("\nVariable Assignment:\n");
     printf("  VARNAME=value     - Set a shell variable\n");
     printf("  $VARNAME          - Use variable in commands\n");
     printf("\nEnhanced Features:\n");
     printf("  Tab Completion    - Press Tab to complete commands and filenames\n");
     printf("  History Navigation - Use Up/Down arrows to browse command history\n");
+    printf("  History Search    - Ctrl-R searches the saved history incrementally\n");
     printf("  Line Editing      - Full line editing capabilities\n");
     printf("  I/O Redirection   - < (input), > (output), >> (append)\n");
     printf("  Pipes             - | (connect commands)\n");
     printf("  Command Chaining  - ; (sequential execution)\n");
     printf("  Background Jobs   - & (run in background)\n");
-    printf("  Control Structures- if-then-else-fi conditional execution\n");
+    printf("  Control Structures- if-then-else-fi, while/until-do-done, for-in-do-done\n");
     printf("\nExamples:\n");
     printf("  NAME=\"John Doe\"                 # Set variable\n");
     printf("  echo $NAME                      # Use variable\n");
     printf("  COUNT=5; echo \"Count: $COUNT\"   # Chain with variables\n");
     printf("  if [ \"$NAME\" = \"John Doe\" ]; then echo \"Match\"; fi\n");
-    printf("\nExternal commands are also supported (ls, pwd, grep, etc.)\n");
+    printf("  for f in *.c; do echo \"$f\"; done\n");
+    printf("\nExternal commands are also supported (ls, grep, etc.)\n");
 }
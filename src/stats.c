@@ -0,0 +1,54 @@
+#include "shell.h"
+
+// Cumulative hot-path counters reported by the stats builtin. Updating one
+// is an increment or a clock_gettime() on the vDSO, so they stay on.
+
+shell_stats_t shell_stats;
+
+// Monotonic clock in nanoseconds
+long long stats_clock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void reset_stats() {
+    memset(&shell_stats, 0, sizeof(shell_stats));
+}
+
+static void print_duration(const char* label, long long ns, unsigned long calls) {
+    printf("  %-16s %10.3f ms", label, ns / 1e6);
+    if (calls > 0) {
+        printf("  (%lu calls, %.2f us avg)", calls, ns / 1e3 / calls);
+    }
+    printf("\n");
+}
+
+// stats: print the counters, stats -r: reset them
+void execute_stats(char** args) {
+    if (args[1] != NULL && strcmp(args[1], "-r") == 0) {
+        reset_stats();
+        return;
+    }
+    
+    printf("Shell statistics:\n");
+    printf("  %-16s %10lu\n", "forks", shell_stats.forks);
+    printf("  %-16s %10lu\n", "execs", shell_stats.execs);
+    printf("  %-16s %10lu\n", "jobs reaped", shell_stats.jobs_reaped);
+    printf("  %-16s %10lu\n", "stages elided", shell_stats.stages_elided);
+    print_duration("parse time", shell_stats.parse_ns, shell_stats.parse_calls);
+    print_duration("expansion time", shell_stats.expand_ns, shell_stats.expand_calls);
+    print_duration("wait time", shell_stats.wait_ns, shell_stats.waits);
+}
+
+// Print the report of the time keyword to stderr
+void print_time_report(long long real_ns, struct rusage* usage) {
+    double real = real_ns / 1e9;
+    double user = usage->ru_utime.tv_sec + usage->ru_utime.tv_usec / 1e6;
+    double sys = usage->ru_stime.tv_sec + usage->ru_stime.tv_usec / 1e6;
+    
+    fprintf(stderr, "\nreal\t%dm%.3fs\n", (int)(real / 60), real - 60 * (int)(real / 60));
+    fprintf(stderr, "user\t%dm%.3fs\n", (int)(user / 60), user - 60 * (int)(user / 60));
+    fprintf(stderr, "sys\t%dm%.3fs\n", (int)(sys / 60), sys - 60 * (int)(sys / 60));
+    fprintf(stderr, "maxrss\t%ld KB\n", usage->ru_maxrss);
+}
@@ -0,0 +1,131 @@
+#include "shell.h"
+#include <errno.h>
+#include <sys/mman.h>
+
+// Command substitution: the output of $(...) and `...`.
+//
+// The command is parsed and run by the shell itself, not handed to a
+// second shell. Normally it runs in a forked child writing into a pipe
+// that is read into a buffer grown by doubling. A lone builtin without
+// side effects on the shell is run in the shell instead: its stdout is
+// pointed at a memfd for the duration (a pipe could fill up and block,
+// as nothing reads it until the builtin returns), so no fork happens.
+
+// Builtins that only print, safe to run without a subshell. jobs and
+// history are left out: they reap children and read files, which a
+// subshell must not do on the shell's behalf.
+static char* pure_builtins[] = {"echo", "printf", "pwd", "true", "false", ":", "help", "test", "[", "[[", NULL};
+
+// Exit status of the last substitution, which a command made only of
+// assignments (or of words that expanded to nothing) returns
+int substitution_status = 0;
+
+static int runs_in_shell(node_t* root) {
+    node_t* node = root->body;
+    if (node == NULL || node->next != NULL || node->type != NODE_PIPELINE) return 0;
+    
+    pipeline_t* pipeline = node->pipeline;
+    command_t* cmd = &pipeline->commands[0];
+    if (pipeline->num_commands != 1 || pipeline->background || pipeline->timed || cmd->args[0] == NULL ||
+        cmd->input_file != NULL || cmd->here_text != NULL || cmd->output_file != NULL) {
+        return 0;
+    }
+    for (int i = 0; pure_builtins[i] != NULL; i++) {
+        if (strcmp(cmd->args[0], pure_builtins[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+// Run the builtin with stdout captured in a memfd
+static char* capture_in_shell(node_t* root, size_t* length) {
+    int fd = memfd_create("substitution", MFD_CLOEXEC);
+    int saved = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    if (fd < 0 || saved < 0) {
+        perror("myshell: substitution");
+        if (fd >= 0) close(fd);
+        if (saved >= 0) close(saved);
+        *length = 0;
+        return malloc(1);
+    }
+    
+    fflush(stdout);
+    dup2(fd, STDOUT_FILENO);
+    substitution_status = execute_node(root);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+    
+    lseek(fd, 0, SEEK_SET);
+    char* output = input_slurp(fd, length);
+    close(fd);
+    return output;
+}
+
+// Run the commands in a forked child and read its output from a pipe
+static char* capture_in_child(node_t* root, size_t* length) {
+    int pipefd[2];
+    
+    *length = 0;
+    if (pipe2(pipefd, O_CLOEXEC) < 0) {
+        perror("myshell: substitution");
+        return malloc(1);
+    }
+    
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return malloc(1);
+    }
+    shell_stats.forks++;
+    
+    if (pid == 0) {
+        // A subshell: everything it starts stays in the shell's group
+        restore_job_signals();
+        job_control = 0;
+        dup2(pipefd[1], STDOUT_FILENO);
+        int status = execute_node(root);
+        fflush(stdout);
+        _exit(status & 0xff);
+    }
+    
+    close(pipefd[1]);
+    char* output = input_slurp(pipefd[0], length);
+    close(pipefd[0]);
+    
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+    substitution_status = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+    return output;
+}
+
+// Output of the commands in text[0..length), without trailing newlines.
+// The result is malloc'd; *output_length gets its length.
+char* command_substitution(const char* text, size_t length, size_t* output_length) {
+    // The parser terminates words in place, so it gets its own copy
+    char* line = strndup(text, length);
+    arena_mark_t mark = arena_mark(&line_arena);
+    node_t* root = parse_program(&line_arena, line, NULL);
+    char* output;
+    
+    if (root == NULL) {
+        *output_length = 0;
+        output = malloc(1);
+        substitution_status = 2;
+    } else if (runs_in_shell(root)) {
+        output = capture_in_shell(root, output_length);
+    } else {
+        output = capture_in_child(root, output_length);
+    }
+    arena_release(&line_arena, mark);
+    free(line);
+    
+    // The commands may have changed files a test already looked at
+    test_cache_clear();
+    
+    while (*output_length > 0 && output[*output_length - 1] == '\n') (*output_length)--;
+    output[*output_length] = '\0';
+    return output;
+}
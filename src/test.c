@@ -0,0 +1,267 @@
+#include "shell.h"
+#include <fnmatch.h>
+
+// test, [ and [[ run inside the shell, so a condition like [ -f x ] costs
+// no process at all. Returns 0 (true), 1 (false) or 2 (usage error).
+//
+// [[ ]] shares the grammar of test, with && and || in place of -a and -o,
+// and = == != matching the right side as a pattern. Its words arrive
+// unsplit from the parser (see parse_conditional()), so an empty
+// operand is still there.
+//
+// File tests go through a small stat cache. The cache is dropped whenever
+// something other than a test runs (see run_pipeline_untimed()), after
+// each command substitution, before each line and on each pass of a while
+// or until loop, so it only serves back-to-back tests such as an if/elif
+// chain probing the same path.
+
+#define STAT_CACHE_SIZE 16
+
+typedef struct {
+    char* path;
+    int use_lstat;
+    int result;        // return value of stat/lstat
+    struct stat st;
+} stat_cache_entry_t;
+
+static stat_cache_entry_t stat_cache[STAT_CACHE_SIZE];
+static int stat_cache_count = 0;
+static int stat_cache_next = 0; // slot to evict next once full
+
+void test_cache_clear() {
+    for (int i = 0; i < stat_cache_count; i++) {
+        free(stat_cache[i].path);
+        stat_cache[i].path = NULL;
+    }
+    stat_cache_count = 0;
+    stat_cache_next = 0;
+}
+
+static int cached_stat(char* path, int use_lstat, struct stat* st) {
+    for (int i = 0; i < stat_cache_count; i++) {
+        if (stat_cache[i].use_lstat == use_lstat && strcmp(stat_cache[i].path, path) == 0) {
+            *st = stat_cache[i].st;
+            return stat_cache[i].result;
+        }
+    }
+    
+    int result = use_lstat ? lstat(path, st) : stat(path, st);
+    
+    stat_cache_entry_t* entry;
+    if (stat_cache_count < STAT_CACHE_SIZE) {
+        entry = &stat_cache[stat_cache_count++];
+    } else {
+        entry = &stat_cache[stat_cache_next];
+        stat_cache_next = (stat_cache_next + 1) % STAT_CACHE_SIZE;
+        free(entry->path);
+    }
+    entry->path = strdup(path);
+    entry->use_lstat = use_lstat;
+    entry->result = result;
+    entry->st = *st;
+    return result;
+}
+
+static int is_unary_op(char* op) {
+    return op[0] == '-' && op[1] != '\0' && op[2] == '\0' && strchr("bcdefghLnprsSwxz", op[1]) != NULL;
+}
+
+static int is_binary_op(char* op) {
+    static char* ops[] = {"=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le", "-gt", "-ge",
+                          "-nt", "-ot", "-ef", NULL};
+    for (int i = 0; ops[i] != NULL; i++) {
+        if (strcmp(ops[i], op) == 0) return 1;
+    }
+    return 0;
+}
+
+// Parse a decimal integer operand; returns -1 if it is not one
+static int parse_integer(char* s, long* value) {
+    char* end;
+    while (*s == ' ' || *s == '\t') s++;
+    if (*s == '\0') return -1;
+    
+    *value = strtol(s, &end, 10);
+    while (*end == ' ' || *end == '\t') end++;
+    return *end == '\0' ? 0 : -1;
+}
+
+static int unary_test(char* op, char* arg) {
+    struct stat st;
+    
+    switch (op[1]) {
+        case 'z': return arg[0] == '\0';
+        case 'n': return arg[0] != '\0';
+        case 'r': return access(arg, R_OK) == 0;
+        case 'w': return access(arg, W_OK) == 0;
+        case 'x': return access(arg, X_OK) == 0;
+        case 'h':
+        case 'L': return cached_stat(arg, 1, &st) == 0 && S_ISLNK(st.st_mode);
+    }
+    
+    if (cached_stat(arg, 0, &st) != 0) return 0;
+    
+    switch (op[1]) {
+        case 'e': return 1;
+        case 'f': return S_ISREG(st.st_mode);
+        case 'd': return S_ISDIR(st.st_mode);
+        case 'b': return S_ISBLK(st.st_mode);
+        case 'c': return S_ISCHR(st.st_mode);
+        case 'p': return S_ISFIFO(st.st_mode);
+        case 'S': return S_ISSOCK(st.st_mode);
+        case 's': return st.st_size > 0;
+        case 'g': return (st.st_mode & S_ISGID) != 0;
+        case 'u': return (st.st_mode & S_ISUID) != 0;
+    }
+    return 0;
+}
+
+// Returns 0/1 for the comparison, or -1 on a bad integer operand. In [[ ]]
+// the right side of = == != is a pattern.
+static int binary_test(char* left, char* op, char* right, int conditional) {
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) {
+        return conditional ? fnmatch(right, left, 0) == 0 : strcmp(left, right) == 0;
+    }
+    if (strcmp(op, "!=") == 0) {
+        return conditional ? fnmatch(right, left, 0) != 0 : strcmp(left, right) != 0;
+    }
+    if (strcmp(op, "<") == 0) return strcmp(left, right) < 0;
+    if (strcmp(op, ">") == 0) return strcmp(left, right) > 0;
+    
+    if (strcmp(op, "-nt") == 0 || strcmp(op, "-ot") == 0 || strcmp(op, "-ef") == 0) {
+        struct stat a, b;
+        int have_a = cached_stat(left, 0, &a) == 0;
+        int have_b = cached_stat(right, 0, &b) == 0;
+        
+        if (op[1] == 'e') return have_a && have_b && a.st_dev == b.st_dev && a.st_ino == b.st_ino;
+        if (op[1] == 'n') return have_a && (!have_b || a.st_mtime > b.st_mtime);
+        return have_b && (!have_a || a.st_mtime < b.st_mtime);
+    }
+    
+    long a, b;
+    if (parse_integer(left, &a) != 0 || parse_integer(right, &b) != 0) {
+        fprintf(stderr, "test: integer expression expected\n");
+        return -1;
+    }
+    if (strcmp(op, "-eq") == 0) return a == b;
+    if (strcmp(op, "-ne") == 0) return a != b;
+    if (strcmp(op, "-lt") == 0) return a < b;
+    if (strcmp(op, "-le") == 0) return a <= b;
+    if (strcmp(op, "-gt") == 0) return a > b;
+    return a >= b; // -ge
+}
+
+// Recursive descent over args[*pos..end):
+//   expr    := term (-o term)*          (|| in [[ ]])
+//   term    := factor (-a factor)*      (&& in [[ ]])
+//   factor  := '!' factor | '(' expr ')' | primary
+// Each returns 0/1, or -1 after reporting an error.
+static int test_expr(char** args, int* pos, int end, int conditional);
+
+static int test_factor(char** args, int* pos, int end, int conditional) {
+    if (*pos >= end) {
+        fprintf(stderr, "test: argument expected\n");
+        return -1;
+    }
+    
+    char* arg = args[*pos];
+    int left = end - *pos;
+    
+    // A binary operator takes precedence, so [ ! = ! ] compares strings
+    if (left >= 3 && is_binary_op(args[*pos + 1])) {
+        *pos += 3;
+        return binary_test(arg, args[*pos - 2], args[*pos - 1], conditional);
+    }
+    
+    if (strcmp(arg, "!") == 0) {
+        (*pos)++;
+        int result = test_factor(args, pos, end, conditional);
+        return result < 0 ? -1 : !result;
+    }
+    
+    if (strcmp(arg, "(") == 0 && left >= 2) {
+        (*pos)++;
+        int result = test_expr(args, pos, end, conditional);
+        if (result < 0) return -1;
+        if (*pos >= end || strcmp(args[*pos], ")") != 0) {
+            fprintf(stderr, "test: ')' expected\n");
+            return -1;
+        }
+        (*pos)++;
+        return result;
+    }
+    
+    if (left >= 2 && is_unary_op(arg)) {
+        *pos += 2;
+        return unary_test(arg, args[*pos - 1]);
+    }
+    
+    // A lone word is true when non-empty
+    (*pos)++;
+    return arg[0] != '\0';
+}
+
+static int test_term(char** args, int* pos, int end, int conditional) {
+    const char* and_word = conditional ? "&&" : "-a";
+    int result = test_factor(args, pos, end, conditional);
+    while (result >= 0 && *pos < end && strcmp(args[*pos], and_word) == 0) {
+        (*pos)++;
+        int right = test_factor(args, pos, end, conditional);
+        result = right < 0 ? -1 : (result && right);
+    }
+    return result;
+}
+
+static int test_expr(char** args, int* pos, int end, int conditional) {
+    const char* or_word = conditional ? "||" : "-o";
+    int result = test_term(args, pos, end, conditional);
+    while (result >= 0 && *pos < end && strcmp(args[*pos], or_word) == 0) {
+        (*pos)++;
+        int right = test_term(args, pos, end, conditional);
+        result = right < 0 ? -1 : (result || right);
+    }
+    return result;
+}
+
+// Evaluate args[1..end) for the command named args[0]
+static int run_test(char** args, int end, int conditional) {
+    // No expression is false
+    if (end == 1) return 1;
+    
+    int pos = 1;
+    int result = test_expr(args, &pos, end, conditional);
+    if (result >= 0 && pos != end) {
+        fprintf(stderr, "%s: too many arguments\n", args[0]);
+        return 2;
+    }
+    if (result < 0) return 2;
+    return result ? 0 : 1;
+}
+
+// test EXPR, [ EXPR ]
+int execute_test(char** args) {
+    int end = 0;
+    while (args[end] != NULL) end++;
+    
+    // [ needs its closing bracket
+    if (strcmp(args[0], "[") == 0) {
+        if (end < 2 || strcmp(args[end - 1], "]") != 0) {
+            fprintf(stderr, "[: missing ']'\n");
+            return 2;
+        }
+        end--;
+    }
+    return run_test(args, end, 0);
+}
+
+// [[ EXPR ]]
+int execute_conditional(char** args) {
+    int end = 0;
+    while (args[end] != NULL) end++;
+    
+    if (end < 2 || strcmp(args[end - 1], "]]") != 0) {
+        fprintf(stderr, "[[: missing ']]'\n");
+        return 2;
+    }
+    return run_test(args, end - 1, 1);
+}
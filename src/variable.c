@@ -1,130 +1,262 @@
 #include "shell.h"
+#include <ctype.h>
+#include <limits.h>
+
+extern char** environ;
+
+// Variables live in variable_list in the order they were first set, so
+// print_variables() output is stable. variable_index is an open-addressing
+// hash table (linear probing) of positions in variable_list, which makes
+// set_variable()/get_variable() O(1) instead of a strcmp scan. Names are
+// interned in an arena for the life of the shell; values are slab strings
+// that are overwritten in place when the new value fits.
+//
+// The environment is imported at startup as exported variables, and the
+// NAME=value array handed to every command started is built from them. It
+// is rebuilt only when environment_generation has moved, which happens
+// when an exported variable is set, exported or unset. Unset variables
+// keep their entry with a NULL value, as the index has no deletion.
 
 // Global variable list
-variable_t variable_list[MAX_VARIABLES];
+variable_t* variable_list = NULL;
 int variable_count = 0;
 
+static int variable_capacity = 0;
+static int* variable_index = NULL;  // slot holds list position + 1, 0 = empty
+static int variable_index_size = 0; // power of two
+static arena_t variable_names;
+
+// Process ID of the shell itself, for $$ (subshells keep the parent's)
+pid_t shell_pid = 0;
+
+// Bumped whenever the exported variables change
+static unsigned long environment_generation = 1;
+static unsigned long environment_built = 0;  // generation of environment
+static char** environment = NULL;
+static arena_t environment_strings;
+
+static unsigned int hash_string(const char* s) {
+    unsigned int h = 2166136261u; // FNV-1a
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Find the index slot for name: either its entry or the empty slot ending the probe
+static int* variable_slot(const char* name, unsigned int hash) {
+    unsigned int mask = variable_index_size - 1;
+    unsigned int i = hash & mask;
+    
+    while (variable_index[i] != 0) {
+        variable_t* var = &variable_list[variable_index[i] - 1];
+        if (var->hash == hash && strcmp(var->name, name) == 0) break;
+        i = (i + 1) & mask;
+    }
+    return &variable_index[i];
+}
+
+static void variable_index_grow() {
+    free(variable_index);
+    variable_index_size = variable_index_size ? variable_index_size * 2 : 256;
+    variable_index = calloc(variable_index_size, sizeof(int));
+    
+    for (int i = 0; i < variable_count; i++) {
+        *variable_slot(variable_list[i].name, variable_list[i].hash) = i + 1;
+    }
+}
+
 // Initialize variables
 void init_variables() {
-    for (int i = 0; i < MAX_VARIABLES; i++) {
-        variable_list[i].name = NULL;
-        variable_list[i].value = NULL;
+    for (int i = 0; i < variable_count; i++) {
+        slab_release(variable_list[i].value);
     }
-    variable_count = 0;
+    free(variable_list);
+    free(variable_index);
+    arena_free(&variable_names);
     
-    // Set some default environment variables
-    char* home = getenv("HOME");
-    if (home) set_variable("HOME", home);
+    variable_list = NULL;
+    variable_count = 0;
+    variable_capacity = 0;
+    variable_index = NULL;
+    variable_index_size = 0;
+    variable_index_grow();
+    environment_generation++;
     
-    char* user = getenv("USER");
-    if (user) set_variable("USER", user);
+    // Import the environment; every entry stays exported
+    for (char** env = environ; *env != NULL; env++) {
+        char* equals = strchr(*env, '=');
+        if (equals == NULL || equals == *env) continue;
+        
+        char* name = strndup(*env, equals - *env);
+        export_variable(name, equals + 1);
+        free(name);
+    }
     
-    char* pwd = getenv("PWD");
-    if (pwd) set_variable("PWD", pwd);
+    // An inherited SHELL is the user's login shell and is passed on as it
+    // is; without one, SHELL names this shell by its absolute path
+    if (get_variable("SHELL") == NULL) {
+        char path[PATH_MAX];
+        ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+        if (length > 0) {
+            path[length] = '\0';
+            set_variable("SHELL", path);
+        }
+    }
     
-    set_variable("SHELL", "myshell");
+    // Field splitting reads IFS for every expanded line; having it set
+    // saves a scan of the environment each time
+    set_variable("IFS", " \t\n");
+    shell_pid = getpid();
 }
 
 // Set a variable
 int set_variable(char* name, char* value) {
     if (name == NULL || value == NULL) return -1;
     
-    // Check if variable already exists
-    for (int i = 0; i < variable_count; i++) {
-        if (variable_list[i].name != NULL && strcmp(variable_list[i].name, name) == 0) {
-            // Update existing variable
-            free(variable_list[i].value);
-            variable_list[i].value = strdup(value);
-            return 0;
-        }
+    // Cached command locations are only valid for the PATH they came from
+    if (strcmp(name, "PATH") == 0) {
+        clear_command_hash();
     }
     
-    // Add new variable
-    if (variable_count < MAX_VARIABLES) {
-        variable_list[variable_count].name = strdup(name);
-        variable_list[variable_count].value = strdup(value);
-        variable_count++;
+    unsigned int hash = hash_string(name);
+    int* slot = variable_slot(name, hash);
+    
+    // Update existing variable
+    if (*slot != 0) {
+        variable_t* var = &variable_list[*slot - 1];
+        var->value = slab_store(var->value, value);
+        if (var->exported) environment_generation++;
         return 0;
     }
     
-    return -1; // No space
+    // Add new variable
+    if (variable_count == variable_capacity) {
+        variable_capacity = variable_capacity ? variable_capacity * 2 : 64;
+        variable_list = realloc(variable_list, variable_capacity * sizeof(variable_t));
+        if (variable_list == NULL) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    
+    variable_t* var = &variable_list[variable_count];
+    var->name = arena_strdup(&variable_names, name);
+    var->value = slab_store(NULL, value);
+    var->hash = hash;
+    var->exported = 0;
+    *slot = ++variable_count;
+    
+    // Keep the index under 1/2 full so probes stay short
+    if (variable_count * 2 > variable_index_size) {
+        variable_index_grow();
+    }
+    return 0;
 }
 
 // Get a variable value
 char* get_variable(char* name) {
     if (name == NULL) return NULL;
     
-    for (int i = 0; i < variable_count; i++) {
-        if (variable_list[i].name != NULL && strcmp(variable_list[i].name, name) == 0) {
-            return variable_list[i].value;
-        }
+    if (variable_index_size > 0) {
+        int* slot = variable_slot(name, hash_string(name));
+        return *slot != 0 ? variable_list[*slot - 1].value : NULL;
     }
     
-    // Also check environment variables
+    // Before init_variables() only the environment is there
     return getenv(name);
 }
 
-// Expand variables in argument list
-void expand_variables(char*** arglist_ptr) {
-    if (arglist_ptr == NULL || *arglist_ptr == NULL) return;
-    
-    char** arglist = *arglist_ptr;
-    
-    for (int i = 0; arglist[i] != NULL; i++) {
-        char* arg = arglist[i];
-        
-        // Skip if argument is NULL or empty
-        if (arg == NULL || arg[0] == '\0') continue;
-        
-        // Check if argument starts with $ and has more characters
-        if (arg[0] == '$' && arg[1] != '\0') {
-            char* var_name = arg + 1; // Skip the $
-            char* var_value = get_variable(var_name);
-            
-            if (var_value != NULL) {
-                // Replace the argument with the variable value
-                free(arglist[i]);
-                arglist[i] = strdup(var_value);
-            } else {
-                // Variable not found, replace with empty string
-                free(arglist[i]);
-                arglist[i] = strdup("");
-            }
-        }
+// Whether name is a valid variable name
+int is_name(const char* name) {
+    if (!isalpha((unsigned char)name[0]) && name[0] != '_') return 0;
+    for (const char* p = name + 1; *p != '\0'; p++) {
+        if (!isalnum((unsigned char)*p) && *p != '_') return 0;
     }
+    return 1;
 }
 
-// Print all variables
-void print_variables() {
-    printf("Shell variables:\n");
-    int shell_vars_printed = 0;
+// Mark a variable exported, setting it first unless value is NULL. A name
+// exported before it is set reaches the environment once it gets a value.
+int export_variable(char* name, char* value) {
+    if (!is_name(name)) return -1;
     
-    for (int i = 0; i < variable_count; i++) {
-        if (variable_list[i].name != NULL && variable_list[i].value != NULL) {
-            printf("  %s=%s\n", variable_list[i].name, variable_list[i].value);
-            shell_vars_printed++;
-        }
+    // An unset name still needs an entry to carry the flag
+    if (value != NULL || get_variable(name) == NULL) {
+        set_variable(name, value != NULL ? value : "");
+        if (value == NULL) unset_variable(name);
     }
+    variable_list[*variable_slot(name, hash_string(name)) - 1].exported = 1;
+    environment_generation++;
+    return 0;
+}
+
+// Remove a variable. Its entry stays behind with a NULL value.
+int unset_variable(char* name) {
+    if (!is_name(name)) return -1;
     
-    if (shell_vars_printed == 0) {
-        printf("  (no shell variables set)\n");
-    }
+    int* slot = variable_slot(name, hash_string(name));
+    if (*slot == 0) return 0;
     
-    // Also print some important environment variables
-    printf("\nEnvironment variables:\n");
-    char* env_vars[] = {"PATH", "HOME", "USER", "SHELL", "PWD", NULL};
-    int env_vars_printed = 0;
+    variable_t* var = &variable_list[*slot - 1];
+    if (var->exported) environment_generation++;
+    slab_release(var->value);
+    var->value = NULL;
+    var->exported = 0;
     
-    for (int i = 0; env_vars[i] != NULL; i++) {
-        char* value = getenv(env_vars[i]);
-        if (value) {
-            printf("  %s=%s\n", env_vars[i], value);
-            env_vars_printed++;
-        }
+    if (strcmp(name, "PATH") == 0) clear_command_hash();
+    return 0;
+}
+
+// The exported variables as a NULL-terminated NAME=value array for
+// posix_spawn/execve. Valid until the next change to an exported variable.
+char** shell_environment() {
+    if (variable_index_size == 0) return environ;
+    if (environment_built == environment_generation) return environment;
+    
+    int count = 0;
+    for (int i = 0; i < variable_count; i++) {
+        if (variable_list[i].exported && variable_list[i].value != NULL) count++;
     }
     
-    if (env_vars_printed == 0) {
-        printf("  (no environment variables)\n");
+    arena_reset(&environment_strings);
+    free(environment);
+    environment = malloc((count + 1) * sizeof(char*));
+    count = 0;
+    for (int i = 0; i < variable_count; i++) {
+        variable_t* var = &variable_list[i];
+        if (!var->exported || var->value == NULL) continue;
+        
+        size_t name_length = strlen(var->name);
+        size_t value_length = strlen(var->value);
+        char* entry = arena_alloc(&environment_strings, name_length + value_length + 2);
+        memcpy(entry, var->name, name_length);
+        entry[name_length] = '=';
+        memcpy(entry + name_length + 1, var->value, value_length + 1);
+        environment[count++] = entry;
+    }
+    environment[count] = NULL;
+    environment_built = environment_generation;
+    return environment;
+}
+
+// Print all variables: the shell's own, then the exported ones
+void print_variables() {
+    for (int exported = 0; exported <= 1; exported++) {
+        printf(exported ? "\nEnvironment variables:\n" : "Shell variables:\n");
+        int printed = 0;
+        
+        for (int i = 0; i < variable_count; i++) {
+            variable_t* var = &variable_list[i];
+            if (var->value != NULL && var->exported == exported) {
+                printf("  %s=%s\n", var->name, var->value);
+                printed++;
+            }
+        }
+        if (printed == 0) {
+            printf(exported ? "  (no environment variables)\n" : "  (no shell variables set)\n");
+        }
     }
 }
 
@@ -174,19 +306,158 @@ int handle_variable_assignment(char* assignment) {
     strncpy(name, assignment, name_len);
     name[name_len] = '\0';
     
-    char* value = equals + 1;
-    
-    // Handle quoted values
-    if (value[0] == '"' || value[0] == '\'') {
-        char quote = value[0];
-        char* end_quote = strchr(value + 1, quote);
-        if (end_quote != NULL) {
-            *end_quote = '\0';
-            value = value + 1;
-        }
-    }
+    // Quotes are removed and command substitutions run, as in arguments
+    char* value = expand_word(equals + 1);
     
     int result = set_variable(name, value);
     free(name);
     return result;
 }
+
+// ---------------------------------------------------------------------------
+// Command location cache
+//
+// Maps command names to the absolute path found by walking PATH, so each
+// external command pays for the PATH search only once. The table is cleared
+// whenever PATH is changed through set_variable().
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    char* name;
+    char* path;
+    int hits;
+} command_hash_entry_t;
+
+static command_hash_entry_t* command_hash = NULL;
+static int command_hash_size = 0;   // number of slots (power of two)
+static int command_hash_count = 0;  // number of used slots
+
+// Find the slot holding name, or the empty slot where it would go
+static command_hash_entry_t* command_hash_slot(const char* name) {
+    unsigned int mask = command_hash_size - 1;
+    unsigned int i = hash_string(name) & mask;
+    
+    while (command_hash[i].name != NULL && strcmp(command_hash[i].name, name) != 0) {
+        i = (i + 1) & mask;
+    }
+    return &command_hash[i];
+}
+
+static void command_hash_grow() {
+    command_hash_entry_t* old = command_hash;
+    int old_size = command_hash_size;
+    
+    command_hash_size = old_size ? old_size * 2 : 64;
+    command_hash = calloc(command_hash_size, sizeof(command_hash_entry_t));
+    
+    for (int i = 0; i < old_size; i++) {
+        if (old[i].name != NULL) {
+            *command_hash_slot(old[i].name) = old[i];
+        }
+    }
+    free(old);
+}
+
+// Walk PATH for an executable called name; returns a malloc'd path or NULL
+static char* search_path(const char* name) {
+    char* path_var = get_variable("PATH");
+    if (path_var == NULL) path_var = "/usr/local/bin:/usr/bin:/bin";
+    
+    size_t name_len = strlen(name);
+    const char* dir = path_var;
+    
+    while (1) {
+        const char* end = strchr(dir, ':');
+        size_t dir_len = end ? (size_t)(end - dir) : strlen(dir);
+        
+        // An empty PATH entry means the current directory
+        char* candidate = malloc(dir_len + name_len + 3);
+        if (dir_len == 0) {
+            strcpy(candidate, "./");
+        } else {
+            memcpy(candidate, dir, dir_len);
+            candidate[dir_len] = '/';
+            candidate[dir_len + 1] = '\0';
+        }
+        strcat(candidate, name);
+        
+        struct stat st;
+        if (stat(candidate, &st) == 0 && S_ISREG(st.st_mode) && access(candidate, X_OK) == 0) {
+            return candidate;
+        }
+        free(candidate);
+        
+        if (end == NULL) break;
+        dir = end + 1;
+    }
+    return NULL;
+}
+
+// Resolve a command name to the path that should be exec'd.
+// Names containing '/' are used as they are; everything else goes
+// through the cache and is only searched for in PATH on a miss.
+char* lookup_command(char* name) {
+    if (name == NULL || name[0] == '\0') return NULL;
+    if (strchr(name, '/') != NULL) return name;
+    
+    if (command_hash_size == 0) command_hash_grow();
+    
+    command_hash_entry_t* entry = command_hash_slot(name);
+    if (entry->name != NULL) {
+        entry->hits++;
+        return entry->path;
+    }
+    
+    char* path = search_path(name);
+    if (path == NULL) return NULL; // Not cached, so a later install is found
+    
+    // Keep the load factor under 3/4
+    if ((command_hash_count + 1) * 4 > command_hash_size * 3) {
+        command_hash_grow();
+        entry = command_hash_slot(name);
+    }
+    entry->name = strdup(name);
+    entry->path = path;
+    entry->hits = 1;
+    command_hash_count++;
+    return path;
+}
+
+// Forget every cached location
+void clear_command_hash() {
+    for (int i = 0; i < command_hash_size; i++) {
+        if (command_hash[i].name != NULL) {
+            free(command_hash[i].name);
+            free(command_hash[i].path);
+            command_hash[i].name = NULL;
+            command_hash[i].path = NULL;
+            command_hash[i].hits = 0;
+        }
+    }
+    command_hash_count = 0;
+}
+
+// Print cached commands with their hit counts
+void print_command_hash() {
+    if (command_hash_count == 0) {
+        printf("hash: hash table empty\n");
+        return;
+    }
+    
+    printf("hits\tcommand\n");
+    for (int i = 0; i < command_hash_size; i++) {
+        if (command_hash[i].name != NULL) {
+            printf("%4d\t%s\n", command_hash[i].hits, command_hash[i].path);
+        }
+    }
+}
+
+// Search PATH for name and remember it without counting a hit
+int hash_command(char* name) {
+    char* path = lookup_command(name);
+    if (path == NULL) return -1;
+    if (strchr(name, '/') == NULL) {
+        command_hash_slot(name)->hits = 0;
+    }
+    return 0;
+}
@@ -0,0 +1,244 @@
+#include "shell.h"
+#include <errno.h>
+
+// xargs [-0] [-r] [-n max] [-P procs] [-g pattern]... command [args...]
+//
+// Builds command lines from items and runs the command once per batch,
+// packing each batch up to the kernel's real limit: sysconf(_SC_ARG_MAX)
+// less the environment and the command itself. Items are read from stdin
+// (blank-separated with quotes and backslashes as in GNU xargs, or
+// NUL-separated with -0) or come from expanding the -g glob patterns. -P
+// runs up to that many batches at once. With no items the command still
+// runs once, unless -r is given.
+//
+// Any other option is handed to the external xargs unchanged.
+
+// Leave room for the auxiliary vector and alignment, as GNU xargs does
+#define ARG_HEADROOM 2048
+
+// Bytes an argument or environment string costs in the new process image
+static size_t arg_cost(char* arg) {
+    return strlen(arg) + 1 + sizeof(char*);
+}
+
+static size_t environment_size() {
+    size_t size = sizeof(char*);
+    for (char** env = shell_environment(); *env != NULL; env++) {
+        size += arg_cost(*env);
+    }
+    return size;
+}
+
+static void add_item(char*** items, int* count, int* capacity, char* item) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 1024;
+        *items = realloc(*items, *capacity * sizeof(char*));
+    }
+    (*items)[(*count)++] = item;
+}
+
+// Split data in place into items separated by NULs (-0). Otherwise blanks
+// separate them, a backslash makes the next character literal, and '...'
+// or "..." quote anything but a newline. Returns -1 on an unmatched quote.
+static int split_items(char* data, size_t size, int nul_separated, char*** items, int* count, int* capacity) {
+    if (nul_separated) {
+        size_t start = 0;
+        for (size_t i = 0; i <= size; i++) {
+            if (i < size && data[i] != '\0') continue;
+            if (i > start) {
+                data[i] = '\0';
+                add_item(items, count, capacity, data + start);
+            }
+            start = i + 1;
+        }
+        return 0;
+    }
+    
+    // Items are compacted towards the front as quotes are removed
+    char* out = data;
+    char* item = NULL;
+    for (size_t i = 0; i < size; i++) {
+        char c = data[i];
+        if (c == ' ' || c == '\t' || c == '\n') {
+            if (item != NULL) {
+                *out++ = '\0';
+                add_item(items, count, capacity, item);
+                item = NULL;
+            }
+            continue;
+        }
+        if (item == NULL) item = out;
+        
+        if (c == '\\' && i + 1 < size) {
+            *out++ = data[++i];
+        } else if (c == '\'' || c == '"') {
+            size_t close = i + 1;
+            while (close < size && data[close] != c && data[close] != '\n') close++;
+            if (close == size || data[close] == '\n') {
+                fprintf(stderr, "xargs: unmatched %s quote\n", c == '\'' ? "single" : "double");
+                return -1;
+            }
+            memmove(out, data + i + 1, close - i - 1);
+            out += close - i - 1;
+            i = close;
+        } else {
+            *out++ = c;
+        }
+    }
+    if (item != NULL) {
+        *out = '\0';
+        add_item(items, count, capacity, item);
+    }
+    return 0;
+}
+
+// Wait for a batch and fold its status into the overall one
+static int reap_batch(pid_t pid, int result) {
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return result;
+    }
+    if (WIFSIGNALED(status)) return 125;
+    if (WEXITSTATUS(status) == 255) return 124;
+    if (WEXITSTATUS(status) != 0 && result == 0) return 123;
+    return result;
+}
+
+static int external_xargs(char** args) {
+    pid_t pid = spawn_external(args, -1, -1, NULL);
+    if (pid < 0) return -pid;
+    
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+int execute_xargs(char** args) {
+    int nul_separated = 0;
+    int skip_empty = 0;
+    long max_items = 0;
+    long procs = 1;
+    int use_glob = 0;
+    char** items = NULL;
+    int count = 0, capacity = 0;
+    int i = 1;
+    
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+        char* option = args[i];
+        if (strcmp(option, "--") == 0) {
+            i++;
+            break;
+        }
+        if (strcmp(option, "-0") == 0) {
+            nul_separated = 1;
+            continue;
+        }
+        if (strcmp(option, "-r") == 0) {
+            skip_empty = 1;
+            continue;
+        }
+        if (strcmp(option, "-n") != 0 && strcmp(option, "-P") != 0 && strcmp(option, "-g") != 0) {
+            free(items);
+            return external_xargs(args);
+        }
+        if (args[i + 1] == NULL) {
+            fprintf(stderr, "xargs: %s: option requires an argument\n", option);
+            free(items);
+            return 1;
+        }
+        
+        char* value = args[++i];
+        if (option[1] == 'g') {
+            // The matched paths live until the next command line
+            char** matches;
+            int num_matches = glob_pathnames(value, &matches);
+            for (int m = 0; m < num_matches; m++) {
+                add_item(&items, &count, &capacity, matches[m]);
+            }
+            use_glob = 1;
+        } else if (atol(value) <= 0) {
+            fprintf(stderr, "xargs: %s: needs a positive number\n", option);
+            free(items);
+            return 1;
+        } else if (option[1] == 'n') {
+            max_items = atol(value);
+        } else {
+            procs = atol(value);
+        }
+    }
+    
+    // The command and its fixed arguments; echo by default
+    static char* default_command[] = {"echo", NULL};
+    char** command = args[i] != NULL ? &args[i] : default_command;
+    int command_words = 0;
+    size_t budget = sysconf(_SC_ARG_MAX) - environment_size() - ARG_HEADROOM;
+    for (; command[command_words] != NULL; command_words++) {
+        budget -= arg_cost(command[command_words]);
+    }
+    
+    char* data = NULL;
+    if (!use_glob) {
+        size_t size;
+        data = input_slurp(STDIN_FILENO, &size);
+        if (split_items(data, size, nul_separated, &items, &count, &capacity) < 0) {
+            free(items);
+            free(data);
+            return 1;
+        }
+    }
+    
+    // Items read from stdin used it up; the command reads /dev/null
+    int null_stdin = use_glob ? -1 : open("/dev/null", O_RDONLY | O_CLOEXEC);
+    
+    char** argv = malloc((command_words + count + 1) * sizeof(char*));
+    memcpy(argv, command, command_words * sizeof(char*));
+    pid_t* running = malloc(procs * sizeof(pid_t));
+    int num_running = 0;
+    int oldest = 0;
+    int result = 0;
+    
+    fflush(stdout);
+    int next = 0;
+    // Without -r, no items still means one run of the bare command
+    int runs_left = (count == 0 && !skip_empty) ? 1 : 0;
+    while (next < count || runs_left-- > 0) {
+        // Pack as many items as fit in the budget (always at least one)
+        int batch = 0;
+        size_t used = 0;
+        while (next + batch < count && (max_items == 0 || batch < max_items)) {
+            size_t cost = arg_cost(items[next + batch]);
+            if (batch > 0 && used + cost > budget) break;
+            used += cost;
+            batch++;
+        }
+        
+        memcpy(argv + command_words, items + next, batch * sizeof(char*));
+        argv[command_words + batch] = NULL;
+        next += batch;
+        
+        if (num_running == procs) {
+            result = reap_batch(running[oldest], result);
+            oldest = (oldest + 1) % procs;
+            num_running--;
+        }
+        pid_t pid = spawn_external(argv, null_stdin, -1, NULL);
+        if (pid < 0) {
+            result = (pid == -127 || pid == -126) ? -pid : 1;
+            break;
+        }
+        running[(oldest + num_running) % procs] = pid;
+        num_running++;
+    }
+    
+    for (; num_running > 0; num_running--) {
+        result = reap_batch(running[oldest], result);
+        oldest = (oldest + 1) % procs;
+    }
+    
+    if (null_stdin >= 0) close(null_stdin);
+    free(running);
+    free(argv);
+    free(items);
+    free(data);
+    return result;
+}
@@ -0,0 +1,28 @@
+# [[ ]]: no splitting or globbing, pattern matching, && || < > inside
+touch a.c b.c
+
+[[ $UNSET = foo ]]; echo unset=$?
+[[ -z $UNSET ]]; echo empty=$?
+X="a b"
+[[ $X == "a b" ]]; echo nosplit=$?
+[[ * == "*" ]]; echo noglob=$?
+
+[[ $X == a* ]]; echo pattern=$?
+[[ $X == "a*" ]]; echo quoted=$?
+P='a*'
+[[ abc == $P ]]; echo var-pattern=$?
+[[ abc == "$P" ]]; echo quoted-var=$?
+[[ foo != f?x ]]; echo differ=$?
+
+[[ a < b ]]; echo less=$?
+[[ b > a && 1 -eq 1 ]]; echo and=$?
+[[ 1 -eq 2 || x == x ]]; echo or=$?
+[[ ! ( a == b ) ]]; echo not=$?
+[[ -f a.c ]] && echo file
+
+# After && and as a pipeline stage
+true && [[ x ]] && echo chained
+[[ x ]] | cat; echo stage=$?
+
+[[ a == b ]] extra
+echo end
@@ -0,0 +1,44 @@
+# Loops in every position a command can take
+
+# Plain loops, break and continue
+for i in 1 2 3 4 5
+do
+    if [ $i = 2 ]; then continue; fi
+    if [ $i = 4 ]; then break; fi
+    echo loop $i
+done
+echo after=$i
+S=
+while [ ${#S} -lt 3 ]; do S=$S.; echo "S=$S"; done
+until [ "$T" = .. ]; do T=$T.; done; echo T=$T
+for a in 1 2; do for b in x y z; do if [ $b = y ]; then continue 2; fi; echo $a$b; done; done
+
+# After ; && and ||
+echo first; for i in a b; do echo semi-$i; done
+true && while [ "$W" != . ]; do W=.; echo and-while; done
+false || for i in c; do echo or-$i; done
+false && for i in d; do echo never; done
+echo skipped=$?
+
+# As a pipeline stage
+for i in 3 1 2; do echo $i; done | sort -n
+printf 'l1\nl2\n' | while read l; do echo "got $l"; done
+for i in x y; do echo $i; done | while read v; do echo "pair $v"; done | cat
+
+# With redirections; the loop runs in the shell, so variables survive
+for i in 1 2; do echo out$i; done > out.txt
+cat out.txt
+while read l; do last=$l; done < out.txt
+echo last=$last
+
+# In command substitution
+echo $(for i in p q; do echo $i; done)
+
+# Empty word lists and false conditions give status 0
+for i in; do echo never; done
+echo empty=$?
+while false; do :; done; echo wf=$?
+
+# Words after done are a syntax error
+while true; do echo x; done extra
+echo end
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Run every tests/*.sh script through the shell and compare its output
+# (stdout and stderr) with the matching .out file.
+# Usage: tests/run.sh [bindir]
+
+BINDIR=$(cd "${1:-bin}" && pwd)
+TESTDIR=$(cd "$(dirname "$0")" && pwd)
+SCRATCH=$(mktemp -d)
+trap 'rm -rf "$SCRATCH"' EXIT
+
+failed=0
+for script in "$TESTDIR"/*.sh; do
+    name=$(basename "$script" .sh)
+    [ "$name" = run ] && continue
+
+    # Each script starts in an empty directory of its own
+    mkdir "$SCRATCH/$name"
+    (cd "$SCRATCH/$name" && "$BINDIR/myshell" "$script" > ../"$name".actual 2>&1)
+
+    if diff -u "$TESTDIR/$name.out" "$SCRATCH/$name.actual"; then
+        echo "PASS $name"
+    else
+        echo "FAIL $name"
+        failed=1
+    fi
+done
+exit $failed